@@ -0,0 +1,736 @@
+// buffercache.cc
+//	Routines to manage the kernel-wide cache of disk sectors.
+//
+//	A buffer can be in one of three states: unused (sector == -1),
+//	holding a sector (valid), or in transit to/from the disk (busy).
+//	All of the bookkeeping is protected by a single lock, but the
+//	lock is not held across disk transfers -- the buffer is marked
+//	busy instead, so that other threads can keep using the rest
+//	of the cache while one of them waits for the disk.
+//
+//	Replacement uses the CLOCK algorithm: every access sets the
+//	buffer's "referenced" bit, and the clock hand sweeps over the
+//	pool, clearing referenced bits until it finds a buffer that has
+//	not been used since the last sweep.  Dirty victims are written
+//	back before they are reused.
+//
+//	Dirty buffers are written back, in sector order, by the
+//	"flusher" thread, which is woken up once half of the dirty
+//	budget is used.  Writers only wait for it when the budget is
+//	exhausted.
+//
+//	Prefetching is done by a separate kernel thread, the
+//	"prefetcher", which reads in the sectors queued by Prefetch.
+//	Buffers it fills are marked "prefetched" until they are first
+//	read, so that we can tell how much of the read-ahead was useful.
+//
+//	Pinned buffers (see journal.h) are never chosen as victims, nor
+//	written back, and do not count against the dirty budget; the
+//	journal limits how many there can be.
+
+#include "copyright.h"
+#include "buffercache.h"
+#include "synchdisk.h"
+#include "journal.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// EntrySector, HashSector
+//	Functions needed by the hash table to find a buffer by the
+//	sector number it holds.
+//----------------------------------------------------------------------
+
+static int
+EntrySector(CacheEntry *entry)
+{
+    return entry->sector;
+}
+
+static unsigned int
+HashSector(int sector)
+{
+    return (unsigned int) sector;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize an empty buffer cache.
+//
+//	"size" is the number of sector buffers in the cache
+//	"maxDirty" is how many of them may be dirty at once
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache(int size, int maxDirty)
+{
+    ASSERT(size > 0);
+    ASSERT((maxDirty > 0) && (maxDirty <= size));
+    numBuffers = size;
+    buffers = new CacheEntry[numBuffers];
+    for (int i = 0; i < numBuffers; i++) {
+	buffers[i].sector = -1;
+	buffers[i].valid = FALSE;
+	buffers[i].dirty = FALSE;
+	buffers[i].referenced = FALSE;
+	buffers[i].busy = FALSE;
+	buffers[i].prefetched = FALSE;
+	buffers[i].pinned = FALSE;
+    }
+    table = new HashTable<int, CacheEntry *>(EntrySector, HashSector);
+    clockHand = 0;
+    lock = new Lock("buffer cache lock");
+    ioDone = new Condition("buffer cache io");
+    journal = NULL;
+
+    prefetchQueue = new List<int>;
+    prefetchLimit = (numBuffers + 3) / 4;	// leave most of the cache
+						// to demand reads
+    prefetchReady = new Condition("prefetch ready");
+    Thread *t = new Thread("prefetcher");
+    t->Fork(BufferCache::Prefetcher, this);
+
+    numDirty = 0;
+    dirtyLimit = maxDirty;
+    flushNeeded = new Condition("flush needed");
+    dirtyDrained = new Condition("dirty drained");
+    t = new Thread("flusher");
+    t->Fork(BufferCache::Flusher, this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	Write any dirty buffers back to disk, and de-allocate the cache.
+//
+//	Since the prefetcher and the flusher are waiting on
+//	"prefetchReady" and "flushNeeded", we don't deallocate those
+//	(nor the prefetch queue).
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    Flush();
+    delete ioDone;
+    delete lock;
+    delete table;
+    delete [] buffers;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSector
+// 	Read the contents of a disk sector into a buffer, going to the
+//	disk only if the sector is not already in the cache.
+//
+//	"sectorNumber" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSector(int sectorNumber, char* data)
+{
+    ReadSectors(1, &sectorNumber, data);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteSector
+// 	Write the contents of a buffer into the cached copy of a disk
+//	sector.  The sector is only marked dirty; it reaches the disk
+//	when it is evicted or the cache is flushed.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteSector(int sectorNumber, char* data)
+{
+    WriteSectors(1, &sectorNumber, data);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSectors
+// 	Read a list of sectors, going to the disk only for those that
+//	are not already in the cache.
+//
+//	"count" -- the number of sectors to read
+//	"sectors" -- the disk sectors to read
+//	"data" -- the buffer to hold their contents, one after another
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSectors(int count, int *sectors, char* data)
+{
+    ASSERT(data != NULL);
+    Fetch(count, sectors, data);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Prefetch
+// 	Ask for a list of sectors to be read into the cache, without
+//	waiting for them.  The prefetcher thread will read them in
+//	later.  Sectors beyond what the queue can hold are dropped --
+//	read-ahead is only a hint.
+//
+//	"count" -- the number of sectors to prefetch
+//	"sectors" -- the disk sectors to prefetch
+//----------------------------------------------------------------------
+
+void
+BufferCache::Prefetch(int count, int *sectors)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	if ((int) prefetchQueue->NumInList() >= prefetchLimit) {
+	    break;
+	}
+	prefetchQueue->Append(sectors[i]);
+    }
+    prefetchReady->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Fetch
+// 	Bring a list of sectors into the cache.  The missing sectors are
+//	collected into a batch and read with one SynchDisk request, so
+//	that consecutive sectors cost one disk request rather than one
+//	each.
+//
+//	The buffers in the batch are busy until the batch is read in.
+//	Since another thread may be waiting for one of them, we must not
+//	wait for anything ourselves while holding a batch; if GetBuffer
+//	would have to wait, we read in what we have first.
+//
+//	When prefetching ("data" is NULL), we never wait: sectors that
+//	are already cached, or that someone else is bringing in, are
+//	simply skipped.
+//
+//	"count" -- the number of sectors to read
+//	"sectors" -- the disk sectors to read
+//	"data" -- the buffer to hold their contents, one after another,
+//		or NULL when prefetching
+//----------------------------------------------------------------------
+
+void
+BufferCache::Fetch(int count, int *sectors, char* data)
+{
+    bool prefetching = (data == NULL);
+    CacheEntry **batch = new CacheEntry *[count];
+    int *where = new int[count];	// index in "sectors" of each
+    int numBatched = 0;			// batched buffer
+    int i = 0;
+
+    lock->Acquire();
+    while ((i < count) || (numBatched > 0)) {
+	CacheEntry *entry = NULL;
+	if (i < count) {
+	    entry = GetBuffer(sectors[i], !prefetching && (numBatched == 0));
+	}
+
+	if (entry == NULL) {
+	    if (numBatched == 0) {	// prefetching; skip this one
+		i++;
+		continue;
+	    }
+	    FillBuffers(numBatched, batch);	// read in the batch, before
+	    if (!prefetching) {			// we wait or when we're done
+		for (int j = 0; j < numBatched; j++) {
+		    batch[j]->prefetched = FALSE;
+		    bcopy(batch[j]->data, &data[where[j] * SectorSize],
+							SectorSize);
+		}
+	    }
+	    numBatched = 0;
+	    continue;
+	}
+
+	if (entry->valid) {
+	    if (!prefetching) {
+		kernel->stats->numCacheHits++;
+		if (entry->prefetched) {
+		    kernel->stats->numPrefetchHits++;
+		    entry->prefetched = FALSE;
+		}
+		entry->referenced = TRUE;
+		bcopy(entry->data, &data[i * SectorSize], SectorSize);
+	    }
+	} else {
+	    if (prefetching) {
+		kernel->stats->numPrefetches++;
+	    } else {
+		kernel->stats->numCacheMisses++;
+	    }
+	    entry->busy = TRUE;
+	    entry->prefetched = prefetching;
+	    batch[numBatched] = entry;
+	    where[numBatched++] = i;
+	}
+	i++;
+    }
+    lock->Release();
+
+    delete [] where;
+    delete [] batch;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteSectors
+// 	Write a list of sectors into the cache.  As with WriteSector,
+//	the sectors are only marked dirty.
+//
+//	If dirtying another buffer would go over the dirty budget, we
+//	wake the flusher and wait for it to make room.  The buffer may
+//	be reused while we wait, so we look it up again afterwards.
+//
+//	Inside a journal transaction, the buffers are pinned instead,
+//	unless the caller says the sectors are not to be journaled.
+//	A pinned buffer may not change while its group is being logged;
+//	a thread outside any transaction waits for the commit (without
+//	the cache lock, which the commit needs), and looks it up again.
+//
+//	"count" -- the number of sectors to write
+//	"sectors" -- the disk sectors to be written
+//	"data" -- their new contents, one after another
+//	"journaled" -- pin them, inside a transaction?
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteSectors(int count, int *sectors, char* data,
+			bool journaled)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	CacheEntry *entry = GetBuffer(sectors[i]);
+
+	if (entry->pinned && (journal != NULL) && journal->IsCommitting()) {
+	    lock->Release();
+	    journal->WaitForCommit();
+	    lock->Acquire();
+	    i--;				// try this one again
+	    continue;
+	}
+	if (!entry->pinned && journaled && (journal != NULL)
+		&& journal->InTransaction()) {
+	    journal->AddSector(sectors[i]);
+	    if (entry->dirty) {
+		numDirty--;			// now the journal's
+	    }
+	    entry->pinned = TRUE;
+	}
+	if (!entry->pinned && !entry->dirty && (numDirty >= dirtyLimit)) {
+	    kernel->stats->numDirtyStalls++;
+	    flushNeeded->Signal(lock);
+	    dirtyDrained->Wait(lock);
+	    i--;				// try this one again
+	    continue;
+	}
+	if (entry->valid) {
+	    kernel->stats->numCacheHits++;
+	} else {
+	    kernel->stats->numCacheMisses++;
+	}
+	if (!entry->dirty && !entry->pinned) {
+	    numDirty++;
+	    if (numDirty == (dirtyLimit + 1) / 2) {
+		flushNeeded->Signal(lock);	// time to start writing
+	    }
+	}
+	bcopy(&data[i * SectorSize], entry->data, SectorSize);
+						// whole sector is replaced,
+						// so no need to read it first
+	entry->valid = TRUE;
+	entry->dirty = TRUE;
+	entry->referenced = TRUE;
+	entry->prefetched = FALSE;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flush
+// 	Write every dirty buffer back to disk, and wait until they are
+//	all there.  The buffers stay in the cache, now clean.  The dirty
+//	buffers are written in sector order, as one list, so that
+//	neighbouring sectors go out together.
+//
+//	Buffers that the flusher (or an eviction) is already writing
+//	are not written again, but we do wait for them to finish.
+//
+//	The journal's current group is committed first, so that there
+//	are no pinned buffers left to hold back.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flush()
+{
+    CacheEntry **dirtyList = new CacheEntry *[numBuffers];
+
+    if (journal != NULL) {
+	journal->Commit();
+    }
+
+    lock->Acquire();
+    for (;;) {
+	int count = CollectDirty(dirtyList);
+	if (count > 0) {
+	    WriteBack(count, dirtyList);
+	    continue;
+	}
+	if (numDirty == 0) {
+	    break;
+	}
+	ioDone->Wait(lock);		// the rest are being written
+    }
+    lock->Release();
+    delete [] dirtyList;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unpin
+// 	Called by the journal once it has logged a list of pinned
+//	sectors.  They become ordinary dirty buffers, to be written back
+//	by the flusher like any other.
+//
+//	"count" -- the number of sectors
+//	"sectors" -- the pinned sectors
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unpin(int count, int *sectors)
+{
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	CacheEntry *entry;
+	if (table->Find(sectors[i], &entry) && entry->pinned) {
+	    ASSERT(entry->valid && entry->dirty);
+	    entry->pinned = FALSE;
+	    numDirty++;
+	}
+    }
+    if (numDirty >= (dirtyLimit + 1) / 2) {
+	flushNeeded->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Checkpoint
+// 	Called by the journal before it overwrites the log of a group:
+//	make sure each sector of the group is on disk.  Sectors no longer
+//	cached, or clean, are there already; dirty ones are written
+//	back.  A sector that has been pinned again by the next group
+//	must not be written from its buffer, which holds changes not yet
+//	logged; for those we write the contents the journal logged.
+//
+//	"count" -- the number of sectors in the group
+//	"sectors" -- the sectors of the group
+//	"data" -- their logged contents, one after another
+//----------------------------------------------------------------------
+
+void
+BufferCache::Checkpoint(int count, int *sectors, char *data)
+{
+    CacheEntry **list = new CacheEntry *[count];
+    int *pinnedSectors = new int[count];
+    char **pinnedData = new char *[count];
+    int numPinned = 0;
+    CacheEntry *entry;
+
+    lock->Acquire();
+    for (;;) {
+	int numListed = 0;
+	bool inTransit = FALSE;
+	for (int i = 0; i < count; i++) {
+	    if (!table->Find(sectors[i], &entry)) {
+		continue;			// evicted, so written back
+	    }
+	    if (entry->busy) {
+		inTransit = TRUE;
+	    } else if (entry->dirty && !entry->pinned) {
+		list[numListed++] = entry;
+	    }
+	}
+	if (numListed > 0) {
+	    WriteBack(numListed, list);
+	    continue;
+	}
+	if (!inTransit) {
+	    break;
+	}
+	ioDone->Wait(lock);			// let those finish
+    }
+    for (int i = 0; i < count; i++) {
+	if (table->Find(sectors[i], &entry) && entry->pinned) {
+	    pinnedSectors[numPinned] = sectors[i];
+	    pinnedData[numPinned++] = &data[i * SectorSize];
+	}
+    }
+    lock->Release();
+
+    if (numPinned > 0) {
+	kernel->synchDisk->WriteSectors(numPinned, pinnedSectors, pinnedData);
+    }
+    delete [] pinnedData;
+    delete [] pinnedSectors;
+    delete [] list;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::CollectDirty
+// 	Fill in "list" with the dirty buffers that are not busy (nor
+//	pinned), in order of sector number.  Return how many there are.
+//
+//	Must be called with the cache lock held.
+//
+//	"list" -- room for numBuffers buffer pointers
+//----------------------------------------------------------------------
+
+int
+BufferCache::CollectDirty(CacheEntry **list)
+{
+    int count = 0;
+
+    for (int i = 0; i < numBuffers; i++) {
+	CacheEntry *entry = &buffers[i];
+	if (!entry->valid || !entry->dirty || entry->busy || entry->pinned) {
+	    continue;
+	}
+	int j = count++;			// insert in sector order
+	for (; (j > 0) && (list[j - 1]->sector > entry->sector); j--) {
+	    list[j] = list[j - 1];
+	}
+	list[j] = entry;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::GetBuffer
+// 	Return the buffer holding "sectorNumber", or if there is none,
+//	a buffer newly assigned to it (with valid == FALSE).  The
+//	returned buffer is never busy.
+//
+//	Must be called with the cache lock held; the lock may be
+//	released and re-acquired while we wait for the disk.
+//
+//	"sectorNumber" -- the disk sector we want a buffer for
+//	"mayWait" -- if FALSE, return NULL instead of waiting for
+//		another thread's transfer to finish
+//----------------------------------------------------------------------
+
+CacheEntry *
+BufferCache::GetBuffer(int sectorNumber, bool mayWait)
+{
+    CacheEntry *entry;
+
+    ASSERT(lock->IsHeldByCurrentThread());
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    for (;;) {
+	if (table->Find(sectorNumber, &entry)) {
+	    if (!entry->busy) {
+		return entry;			// found it
+	    }
+	    if (!mayWait) {
+		return NULL;
+	    }
+	    ioDone->Wait(lock);			// someone else is moving it
+	    continue;				// to/from disk; look again
+	}
+
+	entry = FindVictim();
+	if (entry == NULL) {			// every buffer is busy
+	    if (!mayWait) {
+		return NULL;
+	    }
+	    ioDone->Wait(lock);
+	    continue;
+	}
+	if (entry->valid && entry->dirty) {
+	    WriteBack(1, &entry);		// the cache may have changed
+	    continue;				// while we were writing
+	}
+
+	if (entry->sector != -1) {
+	    table->Remove(entry->sector);
+	    kernel->stats->numCacheEvictions++;
+	    if (entry->prefetched) {		// read in for nothing
+		kernel->stats->numPrefetchWasted++;
+	    }
+	}
+	entry->sector = sectorNumber;
+	entry->valid = FALSE;
+	entry->dirty = FALSE;
+	entry->referenced = FALSE;
+	entry->prefetched = FALSE;
+	table->Insert(entry);
+	return entry;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FindVictim
+// 	Choose a buffer to hold a new sector, using the CLOCK algorithm.
+//	Unused buffers are taken right away; otherwise, the first buffer
+//	whose referenced bit is clear is chosen, clearing referenced bits
+//	as the hand passes over them.  Busy and pinned buffers are skipped.
+//
+//	Return NULL if every buffer is busy or pinned.
+//----------------------------------------------------------------------
+
+CacheEntry *
+BufferCache::FindVictim()
+{
+    for (int i = 0; i < 2 * numBuffers; i++) {	// two sweeps are enough
+	CacheEntry *entry = &buffers[clockHand];	// to clear every bit
+	clockHand = (clockHand + 1) % numBuffers;
+
+	if (entry->busy || entry->pinned) {
+	    continue;
+	}
+	if ((entry->sector == -1) || !entry->referenced) {
+	    return entry;
+	}
+	entry->referenced = FALSE;		// second chance
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::FillBuffers
+// 	Read the sectors assigned to a list of buffers in from disk,
+//	with a single SynchDisk request.  The caller has already marked
+//	the buffers busy; they are valid and no longer busy on return.
+//
+//	Must be called with the cache lock held.
+//
+//	"count" -- the number of buffers to fill
+//	"entries" -- the buffers to be filled
+//----------------------------------------------------------------------
+
+void
+BufferCache::FillBuffers(int count, CacheEntry **entries)
+{
+    if (count == 0) {
+	return;
+    }
+
+    int *sectors = new int[count];
+    char **data = new char *[count];
+    for (int i = 0; i < count; i++) {
+	ASSERT(entries[i]->busy && !entries[i]->valid);
+	sectors[i] = entries[i]->sector;
+	data[i] = entries[i]->data;
+    }
+
+    lock->Release();
+    kernel->synchDisk->ReadSectors(count, sectors, data);
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	entries[i]->valid = TRUE;
+	entries[i]->referenced = TRUE;
+	entries[i]->busy = FALSE;
+    }
+    ioDone->Broadcast(lock);
+
+    delete [] data;
+    delete [] sectors;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteBack
+// 	Write a list of dirty buffers to disk, with a single SynchDisk
+//	request.  The buffers are marked busy for the duration of the
+//	transfer, so the cache lock can be released.
+//
+//	Must be called with the cache lock held.
+//
+//	"count" -- the number of buffers to write
+//	"entries" -- the dirty buffers to be written
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteBack(int count, CacheEntry **entries)
+{
+    int *sectors = new int[count];
+    char **data = new char *[count];
+    for (int i = 0; i < count; i++) {
+	ASSERT(entries[i]->valid && entries[i]->dirty && !entries[i]->busy);
+	entries[i]->busy = TRUE;
+	sectors[i] = entries[i]->sector;
+	data[i] = entries[i]->data;
+    }
+
+    lock->Release();
+    kernel->synchDisk->WriteSectors(count, sectors, data);
+    lock->Acquire();
+    for (int i = 0; i < count; i++) {
+	entries[i]->dirty = FALSE;
+	entries[i]->busy = FALSE;
+    }
+    numDirty -= count;
+    ioDone->Broadcast(lock);
+    dirtyDrained->Broadcast(lock);
+
+    delete [] data;
+    delete [] sectors;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Prefetcher
+// 	Body of the prefetch thread: wait for sectors to be queued by
+//	Prefetch, and read them into the cache.  Never returns.
+//
+//	"data" -- the buffer cache
+//----------------------------------------------------------------------
+
+void
+BufferCache::Prefetcher(void *data)
+{
+    BufferCache *cache = (BufferCache *) data;
+
+    for (;;) {
+	cache->lock->Acquire();
+	while (cache->prefetchQueue->IsEmpty()) {
+	    cache->prefetchReady->Wait(cache->lock);
+	}
+	int count = cache->prefetchQueue->NumInList();
+	int *sectors = new int[count];
+	for (int i = 0; i < count; i++) {
+	    sectors[i] = cache->prefetchQueue->RemoveFront();
+	}
+	cache->lock->Release();
+
+	cache->Fetch(count, sectors, NULL);
+	delete [] sectors;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flusher
+// 	Body of the flusher thread: whenever it is woken up, write all
+//	the dirty buffers back to disk in sector order, so the head
+//	sweeps across the disk once.  It goes back to sleep when fewer
+//	than half the dirty budget is in use.  Never returns.
+//
+//	"data" -- the buffer cache
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flusher(void *data)
+{
+    BufferCache *cache = (BufferCache *) data;
+    CacheEntry **dirtyList = new CacheEntry *[cache->numBuffers];
+
+    cache->lock->Acquire();
+    for (;;) {
+	while (cache->numDirty < (cache->dirtyLimit + 1) / 2) {
+	    cache->flushNeeded->Wait(cache->lock);
+	}
+	int count = cache->CollectDirty(dirtyList);
+	if (count == 0) {		// all being written by others;
+	    cache->ioDone->Wait(cache->lock);	// wait for them
+	    continue;
+	}
+	kernel->stats->numFlusherWrites += count;
+	cache->WriteBack(count, dirtyList);
+    }
+}
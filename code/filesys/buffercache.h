@@ -0,0 +1,160 @@
+// buffercache.h
+//	Data structures for the kernel-wide cache of disk sectors.
+//
+//	The buffer cache sits between the file system and the synchronous
+//	disk.  Every sector the file system reads or writes -- file headers,
+//	indirect blocks, directory and bitmap contents, and ordinary file
+//	data -- goes through here, so that repeated accesses to the same
+//	sector are satisfied from memory instead of the disk.
+//
+//	The cache is a fixed pool of sector-sized buffers, found by
+//	sector number through a hash table.  When a new sector has to be
+//	brought in, a victim buffer is chosen with the CLOCK (second
+//	chance) algorithm.  Writes only modify the buffer; dirty buffers
+//	are written back to disk by a "flusher" kernel thread, when they
+//	are evicted, or when the cache is flushed (by the Fsync system
+//	call, and at the latest when Nachos halts).
+//
+//	The number of dirty buffers is limited.  The flusher starts
+//	writing them out once half of that budget is used up, and a
+//	thread that wants to dirty a buffer beyond the budget waits
+//	until the flusher has made room.
+//
+//	Requests for several sectors at once (from OpenFile::ReadAt and
+//	WriteAt, and from Flush) are passed on to the disk as a list, so
+//	that runs of consecutive sectors cost a single disk request.
+//
+//	The cache can also be asked to read sectors in ahead of time
+//	(see OpenFile::Read).  Such prefetch requests are queued and
+//	carried out by a kernel thread, so the thread asking for them
+//	does not wait for the disk.
+//
+//	Sectors written inside a journal transaction (see journal.h) are
+//	"pinned": they stay in the cache, dirty, and are not written back
+//	until the journal has logged them and unpins them.
+
+#include "copyright.h"
+
+#ifndef BUFFERCACHE_H
+#define BUFFERCACHE_H
+
+#include "disk.h"
+#include "hash.h"
+#include "list.h"
+#include "synch.h"
+
+class Journal;
+
+#define NumCacheBuffers 	64	// default size of the buffer cache
+					// (by default, at most half of it
+					// may be dirty)
+
+// The following class defines one buffer in the cache.
+//
+// Internal data structures kept public so that BufferCache operations
+// can access them directly.
+
+class CacheEntry {
+  public:
+    int sector;				// Disk sector held in this buffer,
+					//   -1 if the buffer is unused
+    bool valid;				// Does "data" hold the contents
+					//   of "sector"?
+    bool dirty;				// Has "data" been modified since
+					//   it was last written to disk?
+    bool referenced;			// Used since the clock hand last
+					//   passed over this buffer?
+    bool busy;				// Is a disk transfer in progress
+					//   on this buffer?
+    bool prefetched;			// Read in ahead of time, and not
+					//   yet asked for?
+    bool pinned;			// Dirty, but held back until the
+					//   journal has logged it?
+    char data[SectorSize];		// Contents of the sector
+};
+
+// The following class defines the buffer cache.  It exports the same
+// ReadSector/WriteSector interface as the synchronous disk, so the
+// file system can use it as a drop-in replacement.
+//
+// While a buffer is being transferred to or from the disk it is
+// marked busy, and the cache lock is released; other threads wanting
+// the same buffer wait on "ioDone" until the transfer completes.
+
+class BufferCache {
+  public:
+    BufferCache(int numBuffers, int maxDirty);
+					// Initialize an empty cache
+    ~BufferCache();			// Flush and de-allocate the cache
+
+    void ReadSector(int sectorNumber, char* data);
+    					// Read/write a disk sector through
+					// the cache
+    void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int count, int *sectors, char* data);
+    void WriteSectors(int count, int *sectors, char* data,
+			bool journaled = TRUE);
+    					// Read/write a list of sectors; the
+					// i'th sector's contents are at
+					// data[i * SectorSize].  File data
+					// is not "journaled", even inside
+					// a transaction
+
+    void Prefetch(int count, int *sectors);
+					// Start reading sectors in, without
+					// waiting for them
+
+    void Flush();			// Write all dirty buffers back
+					// to disk, and wait until they
+					// are there
+
+    int NumBuffers() { return numBuffers; }
+    void SetJournal(Journal *j) { journal = j; }
+					// Pin sectors written inside
+					// transactions of "j"
+    void Unpin(int count, int *sectors);// The journal has logged these
+    void Checkpoint(int count, int *sectors, char *data);
+					// Make sure these sectors are on
+					// disk, as of "data" if still pinned
+
+  private:
+    int numBuffers;			// Number of buffers in the pool
+    CacheEntry *buffers;		// The pool of buffers
+    HashTable<int, CacheEntry *> *table;// Map sector # -> buffer holding it
+    int clockHand;			// Where the CLOCK sweep resumes
+    Lock *lock;				// Mutual exclusion for cache state
+    Condition *ioDone;			// Signalled when a buffer stops
+					// being busy
+    Journal *journal;			// Journal of metadata updates, or
+					// NULL
+    List<int> *prefetchQueue;		// Sectors waiting to be prefetched
+    int prefetchLimit;			// Most sectors allowed in the queue
+    Condition *prefetchReady;		// Signalled when the queue is
+					// no longer empty
+
+    void Fetch(int count, int *sectors, char* data);
+					// Bring sectors into the cache, and
+					// copy them out unless "data" is NULL
+    static void Prefetcher(void *data);	// Body of the prefetch thread
+
+    int numDirty;			// Number of dirty buffers, not
+					// counting pinned ones
+    int dirtyLimit;			// Most dirty buffers allowed
+    Condition *flushNeeded;		// Signalled to wake the flusher
+    Condition *dirtyDrained;		// Signalled when numDirty goes down
+    int CollectDirty(CacheEntry **list);// Find the dirty buffers, sorted
+					// by sector number
+    static void Flusher(void *data);	// Body of the flusher thread
+
+    CacheEntry *GetBuffer(int sectorNumber, bool mayWait = TRUE);
+					// Return the buffer for a sector,
+					// allocating one if necessary
+    CacheEntry *FindVictim();		// Pick a buffer to reuse
+    void FillBuffers(int count, CacheEntry **entries);
+					// Read busy buffers in from disk
+    void WriteBack(int count, CacheEntry **entries);
+					// Write dirty buffers to disk
+};
+
+#endif // BUFFERCACHE_H
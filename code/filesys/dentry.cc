@@ -0,0 +1,114 @@
+// dentry.cc
+//	Routines to manage the cache of path name lookups.
+//
+//	Directory entries only keep the first FileNameMaxLen characters
+//	of a name, and lookups only compare that many; the cache keys on
+//	the same prefix, so that it agrees with the directory about which
+//	names are the same.
+
+#include "copyright.h"
+#include "main.h"
+#include "dentry.h"
+#include "directory.h"
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache of lookups.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    table = new std::map<DentryKey, Dentry>;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    delete table;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MakeKey
+// 	Return the key for looking up "name" in the directory whose
+//	header is at "dirSector".
+//----------------------------------------------------------------------
+
+DentryCache::DentryKey
+DentryCache::MakeKey(int dirSector, char *name)
+{
+    int length = 0;
+
+    while ((length < FileNameMaxLen) && (name[length] != '\0'))
+	length++;
+    return DentryKey(dirSector, std::string(name, length));
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Look for the outcome of looking up "name" in a directory.
+//	Return FALSE if it is not cached.  Otherwise, return TRUE, with
+//	the sector of the file's header (-1 if there is no such file) in
+//	"sector", and whether it is a directory in "isDir".
+//
+//	"dirSector" -- sector of the directory's header
+//	"name" -- the name to look up
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(int dirSector, char *name, int *sector, bool *isDir)
+{
+    std::map<DentryKey, Dentry>::iterator it = 
+					table->find(MakeKey(dirSector, name));
+
+    if (it == table->end()) {
+	kernel->stats->numDentryMisses++;
+	return FALSE;
+    }
+    kernel->stats->numDentryHits++;
+    *sector = it->second.sector;
+    *isDir = it->second.isDir;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Remember the outcome of looking up "name" in a directory,
+//	replacing whatever was cached for it.
+//
+//	"dirSector" -- sector of the directory's header
+//	"name" -- the name looked up
+//	"sector" -- sector of the file's header, -1 if there is none
+//	"isDir" -- is the file a directory?
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int dirSector, char *name, int sector, bool isDir)
+{
+    DentryKey key = MakeKey(dirSector, name);
+
+    if ((table->find(key) == table->end()) 
+		&& ((int) table->size() >= DentryCacheSize)) {
+	table->erase(table->begin());		// make room
+    }
+    Dentry &entry = (*table)[key];
+    entry.sector = sector;
+    entry.isDir = (sector != -1) && isDir;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Invalidate
+// 	Forget whatever is cached for "name" in a directory.
+//
+//	"dirSector" -- sector of the directory's header
+//	"name" -- the name to forget
+//----------------------------------------------------------------------
+
+void
+DentryCache::Invalidate(int dirSector, char *name)
+{
+    table->erase(MakeKey(dirSector, name));
+}
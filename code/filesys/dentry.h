@@ -0,0 +1,62 @@
+// dentry.h
+//	Data structures for the cache of path name lookups.
+//
+//	Resolving a path name means looking up each of its components in
+//	the directory named by the previous one; without a cache, every
+//	component costs reading a whole directory file.  The dentry
+//	("directory entry") cache remembers the outcome of recent lookups:
+//	for a (directory, name) pair, the sector of the named file's
+//	header and whether it is a directory -- or that there is no such
+//	name (a "negative" entry), which is just as useful to know when
+//	creating files.
+//
+//	The file system keeps the cache up to date as it adds and removes
+//	names (see FileSystem::Create, MakeDir, Remove).
+
+#include "copyright.h"
+
+#ifndef DENTRY_H
+#define DENTRY_H
+
+#include <map>
+#include <string>
+
+#define DentryCacheSize		256	// most lookups remembered at once
+
+// The following class defines the outcome of one lookup.
+
+class Dentry {
+  public:
+    int sector;				// Sector of the file header,
+					//   -1 if the name is not there
+    bool isDir;				// Is the file a directory?
+};
+
+// The following class defines the cache of lookups, keyed by the
+// sector of the directory's header and the name looked up in it.
+// When the cache is full, an arbitrary entry is dropped.
+
+class DentryCache {
+  public:
+    DentryCache();			// Initialize an empty cache
+    ~DentryCache();
+
+    bool Lookup(int dirSector, char *name, int *sector, bool *isDir);
+					// Return TRUE if the lookup of
+					// "name" in "dirSector" is cached,
+					// with its outcome
+    void Enter(int dirSector, char *name, int sector, bool isDir);
+					// Remember the outcome of a lookup;
+					// "sector" is -1 if not found
+    void Invalidate(int dirSector, char *name);
+					// Forget a lookup
+
+  private:
+    typedef std::pair<int, std::string> DentryKey;
+
+    std::map<DentryKey, Dentry> *table;	// The cached lookups
+
+    DentryKey MakeKey(int dirSector, char *name);
+};
+
+#endif // DENTRY_H
@@ -11,9 +11,25 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	The table is kept as a hash table: an entry for "name" lives at
+//	the slot HashName(name) picks, or -- if that slot was taken -- at
+//	one of the slots after it (linear probing).  Removing a file
+//	leaves a "deleted" marker behind, so that lookups of names
+//	further along the probe sequence still find them; the marker's
+//	slot is reused by the next Add.  When the table gets three
+//	quarters full, it is rehashed into one INCREASE_FACTOR times as
+//	large, and the directory file grows to match.
+//
+//	Slot 0 holds a header (not in use, with DirHeaderMagic as its
+//	sector number) rather than a file.  A directory file whose first
+//	entry is not such a header was written by the old linear format;
+//	FetchFrom rehashes it, and the next WriteBack stores it hashed.
+//
+//	The directory remembers which entries changed since it was read,
+//	and WriteBack writes only the sectors holding them: adding or
+//	removing a file touches one entry, and so (usually) one sector,
+//	however big the directory -- which keeps the journal transaction
+//	around it small.  A rehashed table is written back whole.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +41,39 @@
 #include "directory.h"
 #include "debug.h"
 
+//----------------------------------------------------------------------
+// HashName
+// 	Hash a file name, looking at no more than FileNameMaxLen
+//	characters (the most that is stored in a DirectoryEntry).
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name)
+{
+    unsigned int hash = 5381;
+
+    for (int i = 0; (i < FileNameMaxLen) && (name[i] != '\0'); i++)
+	hash = (hash * 33) ^ (unsigned char) name[i];
+    return hash;
+}
+
+//----------------------------------------------------------------------
+// ClearTable
+// 	Mark every entry of a table empty, and fill in the header.
+//----------------------------------------------------------------------
+
+static void
+ClearTable(DirectoryEntry *table, int size)
+{
+    for (int i = 0; i < size; i++) {
+	table[i].inUse = FALSE;
+	table[i].isDir = FALSE;
+	table[i].sector = EmptySlot;
+	table[i].name[0] = '\0';
+    }
+    table[0].sector = DirHeaderMagic;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -32,15 +81,19 @@
 //	is all we need, but otherwise, we need to call FetchFrom in order
 //	to initialize it from disk.
 //
-//	"size" is the number of entries in the directory
+//	"size" is the number of entries in the directory, including the
+//	header entry
 //----------------------------------------------------------------------
 
 Directory::Directory(int size)
 {
+    ASSERT(size >= 2);
     table = new DirectoryEntry[size];
     tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    ClearTable(table, tableSize);
+    changed = new bool[size];
+    MarkChanged(TRUE);		// nothing of it is on disk yet
+    numUsed = 0;
 }
 
 //----------------------------------------------------------------------
@@ -50,12 +103,15 @@ Directory::Directory(int size)
 
 Directory::~Directory()
 { 
+    delete [] changed;
     delete [] table;
 } 
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The whole file
+//	is read, however big the directory has grown.  A directory in the
+//	old linear format is rehashed as it is read.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,12 +119,46 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    if (size < 2)		// nothing was ever written to it
+	return;
+
+    DirectoryEntry *onDisk = new DirectoryEntry[size];
+    (void) file->ReadAt((char *)onDisk, size * sizeof(DirectoryEntry), 0);
+
+    if (!onDisk[0].inUse && (onDisk[0].sector == DirHeaderMagic)) {
+	delete [] table;
+	delete [] changed;
+	table = onDisk;
+	tableSize = size;
+	changed = new bool[size];
+	MarkChanged(FALSE);
+	numUsed = 0;
+	for (int i = 1; i < tableSize; i++)
+	    if (table[i].sector != EmptySlot)
+		numUsed++;
+    } else {			// old format: a list of entries
+	int numFiles = 0;
+	for (int i = 0; i < size; i++)
+	    if (onDisk[i].inUse)
+		numFiles++;
+	int newSize = size + 1;
+	while (numFiles > (newSize - 1) * 3 / 4)
+	    newSize *= INCREASE_FACTOR;
+	Rebuild(onDisk, size, newSize);
+	delete [] onDisk;
+    }
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk: each run
+//	of changed entries is written with one WriteAt, so that only the
+//	sectors holding them are written.  If the table has grown beyond
+//	the end of the file, the file is extended to hold it, and its
+//	header written back with the table, so that the two go into the
+//	same journal transaction.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
@@ -76,7 +166,99 @@ Directory::FetchFrom(OpenFile *file)
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = tableSize * sizeof(DirectoryEntry);
+    int length = file->Length();
+
+    int onDisk = min(size, length) / sizeof(DirectoryEntry);
+
+    if (length < size) {
+	file->Seek(length);
+	(void) file->Write((char *)table + length, size - length);
+    }
+    for (int i = 0; i < onDisk; i++) {
+	if (changed[i]) {
+	    int first = i;
+	    while ((i < onDisk) && changed[i])
+		i++;
+	    (void) file->WriteAt((char *)&table[first],
+			(i - first) * sizeof(DirectoryEntry),
+			first * sizeof(DirectoryEntry));
+	}
+    }
+    MarkChanged(FALSE);
+    file->Sync();
+}
+
+//----------------------------------------------------------------------
+// Directory::WriteBackSectors
+// 	Return the most sectors the next WriteBack writes, if one more
+//	entry is added ("adding") or removed first, counting those that
+//	extending the directory file writes; for the journal transaction
+//	around it to reserve.
+//
+//	An Add that rehashes the table writes all of it; otherwise, one
+//	entry changes, in at most two sectors, besides those already
+//	changed.
+//
+//	"file" -- file containing the directory contents
+//	"adding" -- is an entry to be added, rather than removed?
+//----------------------------------------------------------------------
+
+int
+Directory::WriteBackSectors(OpenFile *file, bool adding)
+{
+    int size = tableSize;
+    int numSectors = 2;
+    int lastSector = -1;
+
+    if (adding && (numUsed + 1 > (tableSize - 1) * 3 / 4))
+	size = tableSize * INCREASE_FACTOR;
+    if (size != tableSize) {
+	numSectors = divRoundUp(size * sizeof(DirectoryEntry), SectorSize);
+    } else {
+	for (int i = 0; i < tableSize; i++) {
+	    if (!changed[i])
+		continue;
+	    int first = i * sizeof(DirectoryEntry) / SectorSize;
+	    int last = ((i + 1) * sizeof(DirectoryEntry) - 1) / SectorSize;
+	    numSectors += last - max(first - 1, lastSector);
+	    lastSector = last;
+	}
+    }
+    return numSectors + file->GrowSectors(size * sizeof(DirectoryEntry));
+}
+
+//----------------------------------------------------------------------
+// Directory::Probe
+// 	Look up file name in the hash table, and return its location in
+//	the table of directory entries; return -1 if the name isn't in the
+//	directory.  Also set "freeSlot" to the first slot on the name's
+//	probe sequence where it could be added (-1 if the table is full).
+//
+//	"name" -- the file name to look up
+//	"freeSlot" -- where to return the free slot
+//----------------------------------------------------------------------
+
+int
+Directory::Probe(char *name, int *freeSlot)
+{
+    int numBuckets = tableSize - 1;		// slot 0 is the header
+    int start = HashName(name) % numBuckets;
+
+    *freeSlot = -1;
+    for (int i = 0; i < numBuckets; i++) {
+	DirectoryEntry *entry = &table[1 + (start + i) % numBuckets];
+	if (entry->inUse) {
+	    if (!strncmp(entry->name, name, FileNameMaxLen))
+		return entry - table;
+	} else {
+	    if (*freeSlot == -1)
+		*freeSlot = entry - table;
+	    if (entry->sector != DeletedSlot)
+		break;			// never used; name can't be beyond
+	}
+    }
+    return -1;		// name not in directory
 }
 
 //----------------------------------------------------------------------
@@ -90,10 +272,9 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
-    return -1;		// name not in directory
+    int freeSlot;
+
+    return Probe(name, &freeSlot);
 }
 
 //----------------------------------------------------------------------
@@ -118,9 +299,8 @@ Directory::Find(char *name)
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.
+//	If the directory is getting full, it is expanded first.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
@@ -130,63 +310,52 @@ bool
 Directory::Add(char *name, int newSector)
 { 
     DEBUG('f',"now start add file to directory \n");
-    if (FindIndex(name) != -1)
-	return FALSE;
-
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-            table[i].isDir = false;
-            DEBUG('f',"file hdr sector : "<< table[i].sector);
-        return TRUE;
-	}
-
-     Expand(tableSize * INCREASE_FACTOR);        // increase capacity
-    for (int i = 0; i < tableSize; i++) {       // repeat search
-        if (!table[i].inUse) {
-            table[i].inUse = true;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-            table[i].isDir = false;
-            return true;
-        }
-    }
-ASSERT(false);  // should not happen
-    return FALSE;	// no space.  Fix when we have extensible files.
+    return AddEntry(name, newSector, FALSE);
 }
 
 // add a subdirtory 
 bool
 Directory::AddDirectory(char *name, int newSector) {
     DEBUG('f',"now start add directory \n");
-    if (FindIndex(name) != -1)
-        return false;
+    return AddEntry(name, newSector, TRUE);
+}
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = true;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-            table[i].isDir = true;
-            DEBUG('f',"directory hdr sector : "<< table[i].sector);
-        return true;
-    }
+//----------------------------------------------------------------------
+// Directory::AddEntry
+// 	Add a file or subdirectory into the hash table, expanding the
+//	table if it would become more than three quarters full (counting
+//	deleted entries, which lengthen probe sequences just the same).
+//
+//	"name" -- the name of the file being added
+//	"newSector" -- the disk sector containing the added file's header
+//	"isDir" -- is the new entry a directory?
+//----------------------------------------------------------------------
 
-    Expand(tableSize * INCREASE_FACTOR);        // increase capacity
-    for (int i = 0; i < tableSize; i++) {       // repeat search
-        if (!table[i].inUse) {
-            table[i].inUse = true;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-            table[i].isDir = true;
-            return true;
-        }
+bool
+Directory::AddEntry(char *name, int newSector, bool isDir)
+{
+    int freeSlot;
+
+    if (Probe(name, &freeSlot) != -1)
+	return FALSE;			// already there
+
+    if ((freeSlot == -1) || (numUsed + 1 > (tableSize - 1) * 3 / 4)) {
+	Expand(tableSize * INCREASE_FACTOR);	// increase capacity
+	(void) Probe(name, &freeSlot);
+	ASSERT(freeSlot != -1);
     }
 
-    //ASSERT(false);  // should not happen
-    return false;   // no space.  Fix when we have extensible files.
+    DirectoryEntry *entry = &table[freeSlot];
+    if (entry->sector != DeletedSlot)
+	numUsed++;			// a deleted slot was counted already
+    entry->inUse = TRUE;
+    entry->isDir = isDir;
+    entry->sector = newSector;
+    strncpy(entry->name, name, FileNameMaxLen); 
+    entry->name[FileNameMaxLen] = '\0';
+    changed[freeSlot] = TRUE;
+    DEBUG('f', "hdr sector : " << newSector << " in slot " << freeSlot);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -205,6 +374,8 @@ Directory::Remove(char *name)
     if (i == -1)
 	return FALSE; 		// name not in directory
     table[i].inUse = FALSE;
+    table[i].sector = DeletedSlot;
+    changed[i] = TRUE;
     return TRUE;	
 }
 
@@ -256,20 +427,49 @@ Directory::Print()
     delete hdr;
 }
 
-// expand the maximum can hold by a directory , also double the size of the directoryentry table size
+//----------------------------------------------------------------------
+// Directory::Expand
+// 	Grow the directory to "size" entries, rehashing every file into
+//	the larger table (which also drops the deleted entries).
+//----------------------------------------------------------------------
+
 void
 Directory::Expand(int size) {
-    DirectoryEntry *newTable = new(std::nothrow) DirectoryEntry[size];  // create new table
-    for(int i = 0; i < size; ++i) {     // copy over previous table
-        if(i < tableSize)
-            newTable[i] = table[i];
-        else
-            newTable[i].inUse = false;
+    DirectoryEntry *oldTable = table;
+
+    Rebuild(oldTable, tableSize, size);
+    delete [] oldTable;
+}
+
+//----------------------------------------------------------------------
+// Directory::Rebuild
+// 	Replace the table with a new, empty one of "newSize" entries,
+//	and add to it every entry in use in "oldTable".  The caller
+//	de-allocates "oldTable".
+//----------------------------------------------------------------------
+
+void
+Directory::Rebuild(DirectoryEntry *oldTable, int oldSize, int newSize)
+{
+    table = new DirectoryEntry[newSize];
+    tableSize = newSize;
+    ClearTable(table, tableSize);
+    delete [] changed;
+    changed = new bool[newSize];
+    MarkChanged(TRUE);		// every entry may have moved
+    numUsed = 0;
+
+    for (int i = 0; i < oldSize; i++) {
+	if (oldTable[i].inUse) {
+	    int freeSlot;
+	    ASSERT(Probe(oldTable[i].name, &freeSlot) == -1);
+	    ASSERT(freeSlot != -1);
+	    table[freeSlot] = oldTable[i];
+	    numUsed++;
+	}
     }
-    delete[] table;
-    table = newTable;
-    tableSize *= 2;
 }
+
 bool
 Directory::isDirectory(char *name) {
     int i = FindIndex(name);
@@ -281,7 +481,7 @@ Directory::isDirectory(char *name) {
 char *Directory::GetNameBySector(int sector)
 {
     for (int i = 0; i < tableSize; i++)
-        if (table[i].sector == sector)
+        if (table[i].inUse && table[i].sector == sector)
             return table[i].name;
     return "";
 }
@@ -311,4 +511,17 @@ char* Directory::GetFullPath(int sector)
     }
     path = delimeter + path;
     return (char *) path.c_str();
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// Directory::MarkChanged
+// 	Record every entry as changed since the directory was last
+//	written back, or as unchanged.
+//----------------------------------------------------------------------
+
+void
+Directory::MarkChanged(bool value)
+{
+    for (int i = 0; i < tableSize; i++)
+	changed[i] = value;
+}
@@ -6,6 +6,12 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	The table is a hash table of entries, keyed by file name, with
+//	linear probing.  The first entry of the table is not a file, but
+//	a header marking the table as hashed; directories written before
+//	the hashed format have no such header, and are read as a plain
+//	list of entries (and written back hashed).
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -23,6 +29,12 @@
 					// file names are <= 9 characters long
 #define INCREASE_FACTOR 2
 
+#define DirHeaderMagic	0x48736844	// in the "sector" of the header
+					// entry of a hashed directory
+#define EmptySlot	-1		// "sector" of an entry never used
+#define DeletedSlot	-2		// "sector" of an entry whose file
+					// was removed; lookups probe past it
+
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
 // the file's header is to be found on disk.
@@ -53,12 +65,16 @@ class DirectoryEntry {
 class Directory {
   public:
     Directory(int size); 		// Initialize an empty directory
-					// with space for "size" files
+					// with "size" entries (including
+					// the header)
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+    int WriteBackSectors(OpenFile *file, bool adding);
+					// Most sectors WriteBack writes,
+					// after one more Add or Remove
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
@@ -83,9 +99,20 @@ class Directory {
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
+    int numUsed;			// Number of entries (not counting
+					// the header) in use or deleted
+    bool *changed;			// For each entry, has it changed
+					// since the last FetchFrom/WriteBack?
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    int Probe(char *name, int *freeSlot);
+					// FindIndex, also returning where
+					//  "name" could be added
+    bool AddEntry(char *name, int newSector, bool isDir);
+    void Rebuild(DirectoryEntry *oldTable, int oldSize, int newSize);
+					// Rehash entries into a new table
+    void MarkChanged(bool value);	// Set every entry's "changed"
 };
 
 #endif // DIRECTORY_H
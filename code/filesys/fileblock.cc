@@ -1,7 +1,7 @@
 #include "fileblock.h"
 #include "filehdr.h"
 #include "kernel.h"
-#include "synchdisk.h"
+#include "buffercache.h"
 
 
 
@@ -44,11 +44,11 @@ void IndirectBlock::Deallocate(PersistentBitmap *freeMap){
 }
 
 void IndirectBlock::WriteBack(int sector){
-    kernel->synchDisk->WriteSector(sector,(char *)this);
+    kernel->bufferCache->WriteSector(sector,(char *)this);
 }
 
 void IndirectBlock::FetchFrom(int sector){
-    kernel->synchDisk->ReadSector(sector,(char *)this);
+    kernel->bufferCache->ReadSector(sector,(char *)this);
 }
 
 int IndirectBlock::ByteToSector(int offset){
@@ -22,6 +22,9 @@ class IndirectBlock{
 
         int ByteToSector(int offset); // calculate the offset to disk sector nubmer
 
+        int GetSector(int i) { return dataSectors[i]; } // i'th entry, or EMPTY_BLOCK
+        void SetSector(int i, int sector) { dataSectors[i] = sector; }
+
         void Print();
 
     private: 
@@ -7,12 +7,24 @@
 //	table of pointers -- each entry in the table points to the 
 //	disk sector containing that portion of the file data
 //	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
+//	blocks, unless the tree layout is used). The table size is chosen so that the file header
 //	will be just big enough to fit in one disk sector, 
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
 //
+//	Alternatively, a file header can use the extent layout, where
+//	the table describes runs of contiguous sectors instead (see
+//	filehdr.h).  Extents are allocated by looking for free runs in
+//	the bitmap, and by growing the file's last run in place when the
+//	sectors after it are still free, so that a file written
+//	sequentially tends to end up in a few long runs.
+//
+//	The tree layout (the default) uses the table as UNIX does: most
+//	entries point directly at data sectors, and the last three at a
+//	single, a double and a triple indirect block.  The index blocks
+//	are allocated as the file grows into them.
+//
 //	A file header can be initialized in two ways:
 //	   for a new file, by modifying the in-memory data structure
 //	     to point to the newly allocated data blocks
@@ -26,19 +38,62 @@
 
 #include "filehdr.h"
 #include "debug.h"
-#include "synchdisk.h"
+#include "buffercache.h"
 #include "main.h"
 #include "fileblock.h"
 
 /*
 constructor , initial file size would be 0
+"fileLayout" is IndexedLayout or ExtentLayout, for a new file
 */
-FileHeader::FileHeader(){
+FileHeader::FileHeader(int fileLayout){
+    layout=fileLayout;
     for(int i=0;i<NumDirect;i++){
         dataSectors[i]=EMPTY_BLOCK;
+        indirect[i]=NULL;
         numBytes=0;
         numSectors=0;
     }
+    if(layout==ExtentLayout){
+        for(int i=0;i<NumExtents;i++){
+            extents[i].start=EMPTY_BLOCK;
+            extents[i].length=0;
+        }
+    }
+    numMapped=-1;
+    for(int i=0;i<3;i++){
+        levelBlock[i]=NULL;
+        levelSector[i]=EMPTY_BLOCK;
+    }
+}
+
+FileHeader::~FileHeader(){
+    InvalidateIndirect();
+}
+
+//----------------------------------------------------------------------
+// FileHeader::InvalidateIndirect
+// 	Throw away the in-memory copies of the fileblocks (and the extent
+//	offsets), so that the next ByteToSector recomputes them.  Called
+//	whenever the mapping on disk may no longer match what we have
+//	in memory.
+//----------------------------------------------------------------------
+
+void
+FileHeader::InvalidateIndirect()
+{
+    for (int i = 0; i < (int) NumDirect; i++) {
+        if (indirect[i] != NULL) {
+            delete indirect[i];
+            indirect[i] = NULL;
+        }
+    }
+    numMapped = -1;
+    for (int i = 0; i < 3; i++) {
+        delete levelBlock[i];
+        levelBlock[i] = NULL;
+        levelSector[i] = EMPTY_BLOCK;
+    }
 }
 
 
@@ -57,11 +112,93 @@ bool
 FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 { 
     DEBUG('f',"now start file header allocation\n");
+    if (!AllocateSectors(freeMap, divRoundUp(fileSize, SectorSize)))
+        return FALSE;
+    numBytes += fileSize;
+    DEBUG('f', "file header allocated\n");
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Grow
+// 	Lengthen the file to "newLength" bytes, allocating only the
+//	sectors it does not have yet (the last one may have room to
+//	spare).  Return FALSE if there is not enough free space.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newLength" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Grow(PersistentBitmap *freeMap, int newLength)
+{
+    int needSectors = divRoundUp(newLength, SectorSize) - numSectors;
+
+    if ((needSectors > 0) && !AllocateSectors(freeMap, needSectors))
+        return FALSE;
+    if (newLength > numBytes)
+        numBytes = newLength;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GrowSectors
+// 	Return the most sectors of metadata -- this header, once written
+//	back, and the fileblocks -- that adding "needSectors" data
+//	sectors to the file writes, for the journal to reserve.
+//
+//	Extents live in the header.  A tree writes the fileblocks the
+//	new sectors fall in, at each level (the partly full one at
+//	either end of each level included); fewer than two per
+//	PointersPerBlock sectors, all levels together.  The indexed
+//	layout writes back every fileblock up to the last one it uses.
+//
+//	"needSectors" is the number of sectors to add
+//----------------------------------------------------------------------
+
+int
+FileHeader::GrowSectors(int needSectors)
+{
+    if (needSectors <= 0)
+        return 1;
+    if (layout == ExtentLayout)
+        return 1;
+    if (layout == TreeLayout)
+        return 1 + 2 * divRoundUp(needSectors, PointersPerBlock) + 3;
+    return 1 + min((int) NumDirect,
+		divRoundUp(numSectors + needSectors, PointersPerBlock));
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateSectors
+// 	Add "needSectors" data sectors to the end of the file, in
+//	whichever way the file's layout maps them.  The length of the
+//	file is left to the caller.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"needSectors" is the number of sectors to add
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateSectors(PersistentBitmap *freeMap, int needSectors)
+{ 
+    InvalidateIndirect();               // fileblocks are about to change
    
-    int needSectors  = divRoundUp(fileSize, SectorSize);
     if (freeMap->NumClear() < needSectors)
 	return FALSE;		// not enough space
     DEBUG('f',"enough space for the file\n");
+    if (layout == ExtentLayout) {
+        if (!AllocateExtents(freeMap, needSectors))
+            return FALSE;       // file is too fragmented
+        numSectors += needSectors;
+        return TRUE;
+    }
+    if (layout == TreeLayout) {
+        if (!AllocateTree(freeMap, needSectors))
+            return FALSE;       // file too big, or no room for index blocks
+        numSectors += needSectors;
+        return TRUE;
+    }
     IndirectBlock *block;
     int allocated=0;
     for (int i = 0; i < NumDirect && allocated<needSectors; i++) {
@@ -80,9 +217,7 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
     }
     printf("allocated :%d  , need :%d \n",allocated, needSectors);
     ASSERT(needSectors <=allocated);
-     numBytes += fileSize;
-     numSectors  += divRoundUp(fileSize, SectorSize);
-    DEBUG('f', "file header allocated\n");
+     numSectors  += needSectors;
     return true;
 }
 
@@ -97,8 +232,17 @@ void
 FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
     DEBUG('f', "beginning filehdr deallocation\n");
+    InvalidateIndirect();
+    if (layout == ExtentLayout) {
+        DeallocateExtents(freeMap);
+        return;
+    }
+    if (layout == TreeLayout) {
+        DeallocateTree(freeMap);
+        return;
+    }
     IndirectBlock *block;
-    for (int i = 0; i < numSectors; i++) {
+    for (int i = 0; i < (int) NumDirect; i++) {
         int blockSector = dataSectors[i];
         if(blockSector==EMPTY_BLOCK)
             continue;                    // do nothing if we dont have a block here
@@ -125,7 +269,8 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+    InvalidateIndirect();               // they belong to the old contents
+    kernel->bufferCache->ReadSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
@@ -138,7 +283,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    kernel->synchDisk->WriteSector(sector, (char *)this); 
+    kernel->bufferCache->WriteSector(sector, (char *)this); 
 }
 
 //----------------------------------------------------------------------
@@ -148,6 +293,9 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	The fileblock covering the offset is read in the first time it
+//	is needed, and kept for later calls.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
@@ -155,11 +303,18 @@ int
 FileHeader::ByteToSector(int offset)
 {
     int vBlock = offset/SectorSize;
-    IndirectBlock *block =new IndirectBlock();
-    block->FetchFrom(dataSectors[vBlock/MAX_SECTOR]);
-    int pBlock= block->ByteToSector((vBlock%MAX_SECTOR) *SectorSize);
+    if (layout == ExtentLayout)
+        return ExtentToSector(vBlock);
+    if (layout == TreeLayout)
+        return TreeToSector(vBlock);
+    int which = vBlock/MAX_SECTOR;
+    ASSERT(which < (int) NumDirect && dataSectors[which] != EMPTY_BLOCK);
+    if (indirect[which] == NULL) {
+        indirect[which] = new IndirectBlock();
+        indirect[which]->FetchFrom(dataSectors[which]);
+    }
+    int pBlock= indirect[which]->ByteToSector((vBlock%MAX_SECTOR) *SectorSize);
     ASSERT(pBlock>=0 && pBlock < NumSectors);
-    delete block;
     return pBlock;
 
 }
@@ -187,14 +342,25 @@ FileHeader::Print()
     int i, j, k;
     char *data = new char[SectorSize];
 
-    printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    if (layout == ExtentLayout) {
+        printf("FileHeader contents.  File size: %d.  File extents:\n", numBytes);
+        for (i = 0; i < NumExtents && extents[i].length > 0; i++)
+            printf("%d+%d ", extents[i].start, extents[i].length);
+    } else if (layout == TreeLayout) {
+        printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+        for (i = 0; i < numSectors; i++)
+            printf("%d ", TreeToSector(i));
+    } else {
+        printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+        for (i = 0; i < numSectors; i++)
+	    printf("%d ", dataSectors[i]);
+    }
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-    if(dataSectors[i]<0||dataSectors[i]>NumSectors)
+    int sector = (layout == IndexedLayout) ? dataSectors[i] : ByteToSector(i * SectorSize);
+    if(sector<0||sector>NumSectors)
     continue;
-	kernel->synchDisk->ReadSector(dataSectors[i], data);
+	kernel->bufferCache->ReadSector(sector, data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -205,3 +371,322 @@ FileHeader::Print()
     }
     delete [] data;
 }
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateExtents
+// 	Add "needSectors" sectors to the end of an extent-mapped file.
+//	The last extent is grown in place as far as the free map allows;
+//	the rest goes into new extents, each as long as we can find.
+//
+//	Return FALSE, leaving the file and the free map as they were, if
+//	the file would need more than NumExtents extents.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"needSectors" is the number of sectors to add
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateExtents(PersistentBitmap *freeMap, int needSectors)
+{
+    int count = 0;
+    while (count < NumExtents && extents[count].length > 0)
+        count++;
+    int oldCount = count;
+    int oldLastLength = (count > 0) ? extents[count - 1].length : 0;
+
+    if (count > 0) {                    // grow the last run in place
+        Extent *last = &extents[count - 1];
+        int next = last->start + last->length;
+        while (needSectors > 0 && next < NumSectors && !freeMap->Test(next)) {
+            freeMap->Mark(next++);
+            last->length++;
+            needSectors--;
+        }
+    }
+
+    while (needSectors > 0 && count < NumExtents) {
+        int length;
+        int start = freeMap->FindRun(needSectors);
+        if (start != -1)                // first fit, else the longest run
+            length = needSectors;
+        else
+            start = freeMap->FindLongestRun(&length);
+        ASSERT(start != -1);            // caller checked NumClear
+        for (int i = 0; i < length; i++)
+            freeMap->Mark(start + i);
+        extents[count].start = start;
+        extents[count].length = length;
+        count++;
+        needSectors -= length;
+    }
+
+    if (needSectors > 0) {              // out of extents; undo it all
+        for (int i = oldCount; i < count; i++) {
+            for (int j = 0; j < extents[i].length; j++)
+                freeMap->Clear(extents[i].start + j);
+            extents[i].start = EMPTY_BLOCK;
+            extents[i].length = 0;
+        }
+        if (oldCount > 0) {
+            Extent *last = &extents[oldCount - 1];
+            for (int j = oldLastLength; j < last->length; j++)
+                freeMap->Clear(last->start + j);
+            last->length = oldLastLength;
+        }
+        return FALSE;
+    }
+    DEBUG('f', "file now has " << count << " extents");
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DeallocateExtents
+// 	Return every sector of an extent-mapped file to the free map.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::DeallocateExtents(PersistentBitmap *freeMap)
+{
+    for (int i = 0; i < NumExtents && extents[i].length > 0; i++) {
+        for (int j = 0; j < extents[i].length; j++) {
+            ASSERT(freeMap->Test(extents[i].start + j));
+            freeMap->Clear(extents[i].start + j);
+        }
+        extents[i].start = EMPTY_BLOCK;
+        extents[i].length = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ExtentToSector
+// 	ByteToSector for an extent-mapped file: find the extent holding
+//	sector "vBlock" of the file by binary search over the file offset
+//	where each extent starts, computing those offsets first if needed.
+//
+//	"vBlock" is the sector within the file
+//----------------------------------------------------------------------
+
+int
+FileHeader::ExtentToSector(int vBlock)
+{
+    if (numMapped == -1) {
+        int first = 0;
+        for (numMapped = 0; numMapped < NumExtents
+                && extents[numMapped].length > 0; numMapped++) {
+            extentFirst[numMapped] = first;
+            first += extents[numMapped].length;
+        }
+    }
+
+    int lo = 0, hi = numMapped - 1;
+    while (lo < hi) {                   // last extent starting <= vBlock
+        int mid = (lo + hi + 1) / 2;
+        if (extentFirst[mid] <= vBlock)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    ASSERT(numMapped > 0 && vBlock - extentFirst[lo] < extents[lo].length);
+    int pBlock = extents[lo].start + (vBlock - extentFirst[lo]);
+    ASSERT(pBlock >= 0 && pBlock < NumSectors);
+    return pBlock;
+}
+
+//----------------------------------------------------------------------
+// IndexBlocksFor
+// 	Return how many index blocks a tree-mapped file of "numSectors"
+//	data sectors needs: under a root of height h, covering n data
+//	sectors, there are n / P^l blocks (rounded up) at each height l
+//	from 1 to h, where P is the number of pointers in a block.
+//----------------------------------------------------------------------
+
+static int
+IndexBlocksFor(int numSectors)
+{
+    int count = 0, span = 1;
+    int left = numSectors - NumTreeDirect;
+
+    for (int height = 1; height <= 3 && left > 0; height++) {
+        span *= PointersPerBlock;       // data sectors under this root
+        int used = min(left, span);
+        int cover = 1;
+        for (int l = 1; l <= height; l++) {
+            cover *= PointersPerBlock;
+            count += divRoundUp(used, cover);
+        }
+        left -= used;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// FreeTree
+// 	Return a block of a tree-mapped file to the free map, along with
+//	everything below it.
+//
+//	"sector" is the block, "height" its height above the data sectors
+//	(0 for a data sector)
+//----------------------------------------------------------------------
+
+static void
+FreeTree(PersistentBitmap *freeMap, int sector, int height)
+{
+    if (height > 0) {
+        IndirectBlock block;
+        block.FetchFrom(sector);
+        for (int i = 0; i < PointersPerBlock; i++) {
+            if (block.GetSector(i) != EMPTY_BLOCK)
+                FreeTree(freeMap, block.GetSector(i), height - 1);
+        }
+    }
+    ASSERT(freeMap->Test(sector));
+    freeMap->Clear(sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateTree
+// 	Add "needSectors" data sectors to the end of a tree-mapped file,
+//	along with whatever index blocks they need.
+//
+//	Return FALSE, leaving the file and the free map as they were, if
+//	the file would grow past MaxFileSize or the disk is too full.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"needSectors" is the number of sectors to add
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateTree(PersistentBitmap *freeMap, int needSectors)
+{
+    if (numSectors + needSectors > MaxFileSectors)
+        return FALSE;
+    int indexSectors = IndexBlocksFor(numSectors + needSectors)
+                        - IndexBlocksFor(numSectors);
+    if (freeMap->NumClear() < needSectors + indexSectors)
+        return FALSE;
+
+    for (int i = 0; i < needSectors; i++)
+        TreeToSector(numSectors + i, freeMap);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DeallocateTree
+// 	Return every data and index block of a tree-mapped file to the
+//	free map.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::DeallocateTree(PersistentBitmap *freeMap)
+{
+    for (int i = 0; i < (int) NumDirect; i++) {
+        if (dataSectors[i] == EMPTY_BLOCK)
+            continue;
+        FreeTree(freeMap, dataSectors[i], max(0, i - NumTreeDirect + 1));
+        dataSectors[i] = EMPTY_BLOCK;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GetIndexBlock
+// 	Return the index block at "sector", reading it in unless it is
+//	the one last used at this height.  Since files are mostly read
+//	and written sequentially, this usually costs nothing.
+//
+//	"height" is the block's height above the data sectors (1 to 3)
+//	"sector" is where the block is on disk
+//----------------------------------------------------------------------
+
+IndirectBlock *
+FileHeader::GetIndexBlock(int height, int sector)
+{
+    if (levelSector[height - 1] != sector) {
+        if (levelBlock[height - 1] == NULL)
+            levelBlock[height - 1] = new IndirectBlock();
+        levelBlock[height - 1]->FetchFrom(sector);
+        levelSector[height - 1] = sector;
+    }
+    return levelBlock[height - 1];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NewTreeBlock
+// 	Allocate a block for a tree-mapped file.  An index block starts
+//	out with every entry empty, and is written to disk right away.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"height" is the block's height above the data sectors (0 for a
+//	data sector)
+//----------------------------------------------------------------------
+
+int
+FileHeader::NewTreeBlock(PersistentBitmap *freeMap, int height)
+{
+    int sector = freeMap->FindAndSet();
+    ASSERT(sector != -1);               // AllocateTree checked NumClear
+    if (height > 0) {
+        delete levelBlock[height - 1];
+        levelBlock[height - 1] = new IndirectBlock();
+        levelBlock[height - 1]->WriteBack(sector);
+        levelSector[height - 1] = sector;
+    }
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::TreeToSector
+// 	ByteToSector for a tree-mapped file: find the root covering
+//	sector "vBlock" of the file (a direct pointer, or the single,
+//	double or triple indirect block), and walk down from it.
+//
+//	If "freeMap" is given, missing blocks along the way are allocated
+//	from it; otherwise, they had better all be there.
+//
+//	"vBlock" is the sector within the file
+//----------------------------------------------------------------------
+
+int
+FileHeader::TreeToSector(int vBlock, PersistentBitmap *freeMap)
+{
+    int slot, height = 0, span = 1;
+    int index = vBlock;
+
+    if (index < NumTreeDirect) {
+        slot = index;
+    } else {
+        index -= NumTreeDirect;
+        span = PointersPerBlock;        // data sectors under the root
+        for (height = 1; height <= 3 && index >= span; height++) {
+            index -= span;
+            span *= PointersPerBlock;
+        }
+        ASSERT(height <= 3);
+        slot = NumTreeDirect + height - 1;
+    }
+
+    int sector = dataSectors[slot];
+    if (sector == EMPTY_BLOCK) {
+        ASSERT(freeMap != NULL);
+        sector = dataSectors[slot] = NewTreeBlock(freeMap, height);
+    }
+    for (; height > 0; height--) {
+        span /= PointersPerBlock;       // data sectors under each entry
+        IndirectBlock *block = GetIndexBlock(height, sector);
+        int i = index / span;
+        int next = block->GetSector(i);
+        if (next == EMPTY_BLOCK) {
+            ASSERT(freeMap != NULL);
+            next = NewTreeBlock(freeMap, height - 1);
+            block->SetSector(i, next);
+            block->WriteBack(sector);
+        }
+        index %= span;
+        sector = next;
+    }
+    ASSERT(sector >= 0 && sector < NumSectors);
+    return sector;
+}
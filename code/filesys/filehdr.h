@@ -18,22 +18,73 @@
 #include "pbitmap.h"
 
 #define NumDirect 	((SectorSize - 3 * sizeof(int)) / sizeof(int)) //29 
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumExtents	((int) NumDirect / 2)	// extents fit in the same space
+
+// With TreeLayout, the last three entries of the table point to a
+// single, a double and a triple indirect block; the rest point
+// straight at data sectors.
+
+#define PointersPerBlock ((int) (SectorSize / sizeof(int)))	// 32
+#define NumTreeDirect	((int) NumDirect - 3)
+#define SingleIndirect	(NumTreeDirect)		// table index of each root
+#define DoubleIndirect	(NumTreeDirect + 1)
+#define TripleIndirect	(NumTreeDirect + 2)
+#define MaxFileSectors	(NumTreeDirect + PointersPerBlock \
+			 + PointersPerBlock * PointersPerBlock \
+			 + PointersPerBlock * PointersPerBlock * PointersPerBlock)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)	// about 4MB
+
+// The two ways a file header can map a file onto the disk; recorded in
+// the header itself, so that both kinds of files can be read.
+// ExtentLayout is a magic number rather than a small integer, because
+// headers written before the layout was recorded have garbage there.
+
+#define IndexedLayout	0		// table of fileblocks
+#define ExtentLayout	0x45787473	// table of extents
+#define TreeLayout	0x54726565	// direct and multi-level indirect
+					// blocks (the default)
+
+class IndirectBlock;
+
+// An extent is a run of consecutive disk sectors holding consecutive
+// sectors of the file.  An unused extent has length 0.
+
+class Extent {
+  public:
+    int start;				// First disk sector of the run
+    int length;				// Number of sectors in the run
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
 // The file header is organized as a simple table of pointers to
 // data blocks. 
 //
+// With ExtentLayout, the table instead holds up to NumExtents runs of
+// contiguous sectors, so a file laid out in a few long runs can be
+// mapped without any fileblocks, and translating an offset is a binary
+// search over the extents.
+//
+// With TreeLayout, the table is organized as in UNIX: small files only
+// use the direct pointers, and larger ones go on through the single,
+// double and triple indirect blocks, up to MaxFileSize bytes.
+//
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
 // as one disk sector.  Without indirect addressing, this
 // limits the maximum file length to just under 4K bytes.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The constructor only chooses the layout; the file header is then
+// initialized by allocating blocks for the file (if it is a new file),
+// or by reading it from disk.
+//
+// While a header is in memory, the indirect blocks it points to (or
+// the starting file offset of each extent) are kept in memory as well,
+// so that translating a file offset to a disk sector does not cost a
+// disk read.  They are computed lazily, the first time ByteToSector
+// needs them, and are dropped whenever the header is re-read or its
+// blocks are allocated or de-allocated.
 
 class FileHeader {
   public:
@@ -42,6 +93,12 @@ class FileHeader {
 						//  on disk for the file data
     void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
 						//  data blocks
+    bool Grow(PersistentBitmap *bitMap, int newLength);
+						// Lengthen the file, adding
+						//  just the sectors it lacks
+    int GrowSectors(int needSectors);	// Most sectors of metadata adding
+					//  "needSectors" writes, this
+					//  header included
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -53,18 +110,64 @@ class FileHeader {
 
     int FileLength();			// Return the length of the file 
 					// in bytes
+    void SetLength(int newLength) { numBytes = newLength; }
+					// Change it without allocating (the
+					// new bytes are not on disk yet)
+    int AllocatedLength() { return numSectors * SectorSize; }
+					// Bytes the file's sectors hold; may
+					// be less than the length, while
+					// allocation is delayed (inode.h)
 
     void Print();			// Print the contents of the file.
-    int permisstion; 
-    FileHeader();
+    int GetLayout() { return layout; }	// IndexedLayout or ExtentLayout
+    FileHeader(int fileLayout = TreeLayout);
+    ~FileHeader();			// Free the in-memory indirect blocks
 
 
 
   private:
+    int layout;				// How the sectors are mapped
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
        
-    int dataSectors[NumDirect];		// disk sector of fileblocks in the file
+    union {
+	int dataSectors[NumDirect];	// disk sector of fileblocks in the file
+	Extent extents[NumExtents];	// or, runs of sectors in the file
+    };
+
+    // The fields above are the on-disk header; the ones below
+    // only exist in memory, and must stay after them.
+
+    IndirectBlock *indirect[NumDirect];	// in-memory copy of each fileblock,
+					// NULL if not read in yet
+    int extentFirst[NumExtents];	// file sector where each extent starts
+    int numMapped;			// # of extents in extentFirst, or -1
+					// if it has not been computed yet
+    IndirectBlock *levelBlock[3];	// TreeLayout: the index block last
+    int levelSector[3];			// used at each height above the data
+					// sectors, and where it is on disk
+
+    void InvalidateIndirect();		// Forget the in-memory fileblocks
+					// and extent offsets
+    bool AllocateSectors(PersistentBitmap *freeMap, int needSectors);
+					// Add data sectors to the file
+
+    bool AllocateExtents(PersistentBitmap *freeMap, int needSectors);
+    void DeallocateExtents(PersistentBitmap *freeMap);
+    int ExtentToSector(int vBlock);	// ByteToSector, for ExtentLayout
+
+    bool AllocateTree(PersistentBitmap *freeMap, int needSectors);
+    void DeallocateTree(PersistentBitmap *freeMap);
+    int TreeToSector(int vBlock, PersistentBitmap *freeMap = NULL);
+					// ByteToSector, for TreeLayout;
+					// with a "freeMap", allocate any
+					// missing blocks along the way
+    IndirectBlock *GetIndexBlock(int height, int sector);
+					// Read in an index block, through
+					// levelBlock
+    int NewTreeBlock(PersistentBitmap *freeMap, int height);
+					// Allocate an (empty) block of
+					// the tree
 };
 
 #endif // FILEHDR_H
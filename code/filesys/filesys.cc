@@ -25,8 +25,11 @@
 //	directory and/or bitmap, if the operation succeeds, the changes
 //	are written immediately back to disk (the two files are kept
 //	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	modified part of the directory, we simply discard the changed
+//	version, without writing it back to disk.  The bitmap is kept in
+//	memory for as long as Nachos runs, so a failed operation has to
+//	clear any bits it set; only the sectors of the bitmap file that
+//	changed are written back.
 //
 // 	Our implementation at this point has the following restrictions:
 //
@@ -51,6 +54,10 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "dentry.h"
+#include "journal.h"
+#include "inode.h"
+#include "buffercache.h"
 #include "debug.h"
 #include "main.h"
 
@@ -70,25 +77,36 @@
 
 
 
-//to achieve the file heirachy, this func take the relative path of the file and the dirFile sector num of current dir
-int parse_path(char **path, int wdSector) {
+//----------------------------------------------------------------------
+// FileSystem::ParsePath
+// 	Resolve all but the last component of a path name, relative to
+//	a working directory; the path can name files in subdirectories,
+//	"dir/subdir/file".  Each component but the last must be a
+//	directory.
+//
+//	Return the sector of the header of the directory that holds the
+//	last component, and set "path" to just that last component.
+//	Return -1 if some component is missing or is not a directory.
+//
+//	"path" -- the path name, updated to the last component
+//	"wdSector" -- sector of the working directory's header
+//----------------------------------------------------------------------
+
+int
+FileSystem::ParsePath(char **path, int wdSector)
+{
     std::string cur_path(*path), dirname;
     std::string::size_type i;
     while((i = cur_path.find("/")) != std::string::npos) {
-        printf("sector number :%d \n",wdSector);
+        DEBUG(dbgFile, "path lookup in sector " << wdSector);
         dirname = cur_path.substr(0, i);
         cur_path = cur_path.substr(i+1, cur_path.size());
 
-        Directory *dir = new(std::nothrow) Directory(NumDirEntries);
-        OpenFile *dirFile = new(std::nothrow) OpenFile(wdSector);
-        dir->FetchFrom(dirFile);
-        if(!dir->isDirectory((char *) dirname.c_str()))
+        bool isDir;
+        wdSector = LookUp(wdSector, (char *) dirname.c_str(), &isDir);
+        if(wdSector == -1 || !isDir)
             return -1;
-        wdSector = dir->Find((char *) dirname.c_str());
-        delete dir;
-        delete dirFile;
     }
-    printf("sector number :%d \n",wdSector);
     char *filename = new char[cur_path.size() + 1];
     std::copy(cur_path.begin(), cur_path.end(), filename);
     filename[cur_path.size()] = '\0';
@@ -97,27 +115,68 @@ int parse_path(char **path, int wdSector) {
     return wdSector;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::LookUp
+// 	Look up a name in a directory, through the dentry cache; only if
+//	the lookup is not cached is the directory read from disk.
+//
+//	Return the sector of the file's header, or -1 if the directory
+//	has no such name.  Also set "isDir" to whether it is a directory.
+//
+//	"dirSector" -- sector of the directory's header
+//	"name" -- the name to look up
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookUp(int dirSector, char *name, bool *isDir)
+{
+    int sector;
+
+    if (dentries->Lookup(dirSector, name, &sector, isDir))
+        return sector;
+
+    Directory *dir = new(std::nothrow) Directory(NumDirEntries);
+    OpenFile *dirFile = new(std::nothrow) OpenFile(dirSector);
+    dir->FetchFrom(dirFile);
+    sector = dir->Find(name);
+    *isDir = dir->isDirectory(name);
+    dentries->Enter(dirSector, name, sector, *isDir);
+    delete dir;
+    delete dirFile;
+    return sector;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).  
+//	an empty directory, an empty journal, and a bitmap of free sectors
+//	(with almost but not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory, after replaying the
+//	journal in case Nachos stopped in the middle of an update.  The layout used for
+//	new files is whatever the disk was formatted with, which we learn
+//	from the bitmap's file header.
 //
 //	"format" -- should we initialize the disk?
+//	"useExtents" -- when formatting, map files with extents rather
+//		than with direct and indirect blocks
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, bool useExtents)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
+    dentries = new DentryCache;
+    journal = new Journal(format);	// replays the log, if need be
+    kernel->bufferCache->SetJournal(journal);
+    kernel->inodeTable->SetJournal(journal);
     if (format) {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
+        fileLayout = useExtents ? ExtentLayout : TreeLayout;
+        freeMap = new PersistentBitmap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
-	FileHeader *mapHdr = new FileHeader;
-	FileHeader *dirHdr = new FileHeader;
+	FileHeader *mapHdr = new FileHeader(fileLayout);
+	FileHeader *dirHdr = new FileHeader(fileLayout);
 
         DEBUG(dbgFile, "Formatting the file system.");
 
@@ -125,6 +184,8 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	for (int i = 0; i < JournalSectors; i++)
+	    freeMap->Mark(JournalSector + i);
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -163,7 +224,6 @@ FileSystem::FileSystem(bool format)
 	    freeMap->Print();
 	    directory->Print();
         }
-        delete freeMap; 
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
@@ -172,6 +232,14 @@ FileSystem::FileSystem(bool format)
     // the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        ASSERT(freeMapFile->Length() == FreeMapFileSize);
+					// else formatted with another geometry
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+
+        FileHeader *mapHdr = new FileHeader;
+        mapHdr->FetchFrom(FreeMapSector);
+        fileLayout = mapHdr->GetLayout();
+        delete mapHdr;
     }
 }
 
@@ -196,6 +264,8 @@ FileSystem::FileSystem(bool format)
 //	 	no free space for file header
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
+//		the changes would not fit in a journal transaction
+//		  (a large directory to rehash)
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
@@ -209,7 +279,6 @@ bool
 FileSystem::Create(char *name, int initialSize, int wdSector)
 {
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
@@ -218,29 +287,42 @@ FileSystem::Create(char *name, int initialSize, int wdSector)
     DEBUG(dbgFile, "Creating file  " << name << " size   " << initialSize);
 
     //directoryLock->Acquire();
-    wdSector = parse_path(&name, wdSector);
+    wdSector = ParsePath(&name, wdSector);
     if(wdSector < 0) {
         DEBUG('f', "bad path: ");
         //directoryLock->Release();
         return false;
     }
+    bool isDir;
+    if (dentries->Lookup(wdSector, name, &sector, &isDir) && (sector != -1))
+        return FALSE;			// known to be there already
     directory = new Directory(NumDirEntries);
      OpenFile *dirFile = new(std::nothrow) OpenFile(wdSector);
     directory->FetchFrom(dirFile);
+    hdr = new FileHeader(fileLayout);
+    int numSectors = directory->WriteBackSectors(dirFile, TRUE)
+		+ hdr->GrowSectors(divRoundUp(initialSize, SectorSize))
+		+ FreeMapSectors();
+    if (!journal->CanReserve(numSectors)) {
+        DEBUG(dbgFile, "Creating " << name << " needs too big a transaction");
+        delete hdr;
+        delete directory;
+        delete dirFile;
+        return FALSE;
+    }
+    journal->Begin(numSectors);
 
 
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new PersistentBitmap(freeMapFile,NumSectors);
         sector = freeMap->FindAndSet();	// find a sector to hold the file header
-        printf("here!!!!! and sector : %d , name :%s \n",sector,name);
+        DEBUG(dbgFile, "header sector : " << sector << " , name : " << name);
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
         else if (!directory->Add(name, sector))
             success = FALSE;	// no space in directory
 	else {
-    	    hdr = new FileHeader;
 	    if (!hdr->Allocate(freeMap, initialSize))
             	success = FALSE;	// no space on disk for data
 	    else {	
@@ -249,13 +331,17 @@ FileSystem::Create(char *name, int initialSize, int wdSector)
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
     	    	directory->WriteBack(dirFile);
-    	    	freeMap->WriteBack(freeMapFile);
+    	    	FlushFreeMap();
+    	    	dentries->Enter(wdSector, name, sector, FALSE);
 	    }
-            delete hdr;
 	}
-        delete freeMap;
+	if (!success && (sector != -1))
+	    freeMap->Clear(sector);	// give back the header sector
     }
+    journal->End();
+    delete hdr;
     delete directory;
+    delete dirFile;
     return success;
 }
 
@@ -273,41 +359,23 @@ OpenFile *
 FileSystem::Open(char *name, int wdSector)
 { 
 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
 
     DEBUG(dbgFile, "Opening file" << name);
 
-    wdSector = parse_path(&name, wdSector);
+    wdSector = ParsePath(&name, wdSector);
     if(wdSector < 0) {
         DEBUG('f', "can't open ,bad path: ");
        // directoryLock->Release();
         return false;
     }
 
-    OpenFile *dirFile =new OpenFile(wdSector);
-    directory->FetchFrom(dirFile);
-    directory->Print();
-    sector = directory->Find(name); 
-    printf( "name : %s sector: %d \n",name, sector);
-    if (sector >= 0) 	{	
+    bool isDir;
+    sector = LookUp(wdSector, name, &isDir);
+    DEBUG(dbgFile, "name : " << name << " sector: " << sector);
+    if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
-   
-    // initial or update the sync map in kernel
-    if(kernel->OpenFileCount->find(sector)== kernel->OpenFileCount->end())
-    kernel->OpenFileCount->operator[](sector)=1;
-    else
-    {
-        kernel->OpenFileCount->operator[](sector)=kernel->OpenFileCount->operator[](sector)+1;
-    }
-     if(kernel->semaphoreRead->find(sector)== kernel->semaphoreRead->end())
-        kernel->semaphoreRead->operator[](sector)= new Semaphore("readsemaphore",1);
-      if(kernel->semaphoreWrite->find(sector)== kernel->semaphoreRead->end())
-        kernel->semaphoreWrite->operator[](sector) =new Semaphore("writesemaphore",1);
-    }
-    delete directory;
-    delete dirFile;
     return openFile;				// return NULL if not found
 }
 
@@ -329,7 +397,6 @@ bool
 FileSystem::Remove(char *name, int wdSector)
 { 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
     int sector;
     
@@ -337,18 +404,12 @@ FileSystem::Remove(char *name, int wdSector)
 
      DEBUG('f', "starting filesystem remove\n");
     //directoryLock->Acquire();
-    wdSector = parse_path(&name, wdSector);
+    wdSector = ParsePath(&name, wdSector);
     if(wdSector < 0) {
         DEBUG('f', "bad path: %s\n");
         //directoryLock->Release();
         return false;
     }
-// since we use sector num as sync map key, we cannot remove the file while someone opens it
-if(kernel->OpenFileCount->find(wdSector)!=kernel->OpenFileCount->end() && 
-    (kernel->OpenFileCount->operator[](wdSector)) >0){
-        DEBUG('f',"cannot remove file, some thread still holds the openfile of it\n");
-        return false;
-    }
     OpenFile *dirFile = new(std::nothrow) OpenFile(wdSector);
 
     directory = new Directory(NumDirEntries);
@@ -367,22 +428,31 @@ if(kernel->OpenFileCount->find(wdSector)!=kernel->OpenFileCount->end() &&
         //directoryLock->Release();
         return false;
     }
+    // its sectors could be reallocated under whoever has it open
+    if (kernel->inodeTable->IsOpen(sector)) {
+        DEBUG('f',"cannot remove file, some thread still holds the openfile of it\n");
+        delete directory;
+        delete dirFile;
+        return false;
+    }
 
+    journal->Begin(directory->WriteBackSectors(dirFile, FALSE)
+			+ FreeMapSectors());
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
+    kernel->inodeTable->Forget(sector);		// and its cached copy
     directory->Remove(name);
+    dentries->Enter(wdSector, name, -1, FALSE);
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
+    FlushFreeMap();				// flush to disk
     directory->WriteBack(dirFile);        // flush to disk
+    journal->End();
     delete fileHdr;
     delete directory;
     delete dirFile;
-    delete freeMap;
     DEBUG('r', "finished removing file\n");
     return TRUE;
 } 
@@ -420,7 +490,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
@@ -438,7 +507,6 @@ FileSystem::Print()
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
 
@@ -447,7 +515,6 @@ FileSystem::MakeDir(char *name, int initialSize, int wdSector)
 {
     Directory *directory;
     OpenFile *dirFile;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
@@ -455,7 +522,7 @@ FileSystem::MakeDir(char *name, int initialSize, int wdSector)
     DEBUG('f', "Creating file" << name << "size" <<  initialSize);
 
     //directoryLock->Acquire();
-    wdSector = parse_path(&name, wdSector);
+    wdSector = ParsePath(&name, wdSector);
     if(wdSector < 0) {
         DEBUG('f', "bad path: "<< name);
         //directoryLock->Release();
@@ -465,13 +532,26 @@ FileSystem::MakeDir(char *name, int initialSize, int wdSector)
     directory = new(std::nothrow) Directory(NumDirEntries);
     dirFile = new(std::nothrow) OpenFile(wdSector);
     directory->FetchFrom(dirFile);
+    hdr = new(std::nothrow) FileHeader(fileLayout);
+    // the new directory's table is written whole, into its own file
+    int tableSectors = divRoundUp(DirectoryFileSize, SectorSize);
+    int numSectors = directory->WriteBackSectors(dirFile, TRUE)
+                + hdr->GrowSectors(divRoundUp(initialSize, SectorSize))
+                + hdr->GrowSectors(tableSectors) + tableSectors
+                + FreeMapSectors();
+    if (!journal->CanReserve(numSectors)) {
+        DEBUG(dbgFile, "Making " << name << " needs too big a transaction");
+        delete hdr;
+        delete directory;
+        delete dirFile;
+        return false;
+    }
+    journal->Begin(numSectors);
 
     if (directory->Find(name) != -1)
       success = false;          // file is already in directory
     else {
         //diskmapLock->Acquire(); 
-        freeMap = new(std::nothrow) PersistentBitmap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         sector = freeMap->FindAndSet();   // find a sector to hold the file header
         if (sector == -1)       
             success = false;        // no free block for file header 
@@ -479,29 +559,33 @@ FileSystem::MakeDir(char *name, int initialSize, int wdSector)
             success = false;    // no space in directory
         else {
             ASSERT(directory->Find(name) != -1);
-            hdr = new(std::nothrow) FileHeader();
             if (!hdr->Allocate(freeMap, initialSize))
                 success = false;    // no space on disk for data
             else {  
                 success = true; // everthing worked, flush all changes back to disk
                 hdr->WriteBack(sector);         
                 directory->WriteBack(dirFile);
-                freeMap->WriteBack(freeMapFile);
 
                 Directory *newDir = new(std::nothrow) Directory(NumDirEntries);
                 OpenFile *newFile = new(std::nothrow) OpenFile(sector);
                 ASSERT(newDir->AddDirectory(".", sector));
                 ASSERT(newDir->AddDirectory("..", wdSector));
                 newDir->WriteBack(newFile);
+                FlushFreeMap();
+                dentries->Enter(wdSector, name, sector, TRUE);
+                dentries->Enter(sector, ".", sector, TRUE);
+                dentries->Enter(sector, "..", wdSector, TRUE);
                 delete newDir;
                 delete newFile;
             }
-            delete hdr;
         }
-        delete freeMap;
+        if (!success && (sector != -1))
+            freeMap->Clear(sector);     // give back the header sector
         //diskmapLock->Release();
     }
     //directoryLock->Release();
+    journal->End();
+    delete hdr;
     delete directory;
     delete dirFile;
     return success;
@@ -509,12 +593,10 @@ FileSystem::MakeDir(char *name, int initialSize, int wdSector)
 
 int
 FileSystem::ChangeDir(char *name, int wdSector) {
-    Directory *dir;
-    OpenFile *dirFile;
     int sector;
 
     //directoryLock->Acquire();
-    wdSector = parse_path(&name, wdSector);
+    wdSector = ParsePath(&name, wdSector);
     if(wdSector < 0) {
         DEBUG('f', "bad path: "<< name);
         //directoryLock->Release();
@@ -522,23 +604,15 @@ FileSystem::ChangeDir(char *name, int wdSector) {
     }
 
 
-    dirFile = new(std::nothrow) OpenFile(wdSector);
-    dir = new(std::nothrow) Directory(NumDirEntries);
-    dir->FetchFrom(dirFile);
-
-    if(!dir->isDirectory(name)) {
+    bool isDir;
+    sector = LookUp(wdSector, name, &isDir);
+    if(sector == -1 || !isDir) {
         DEBUG('f', "could not find directory " << name);
         //directoryLock->Release();
-        delete dir;
-        delete dirFile;
         return -1;
     }
 
-    sector = dir->Find(name);
-
     //directoryLock->Release();
-    delete dir;
-    delete dirFile;
     return sector;
 }
 
@@ -565,10 +639,55 @@ FileSystem:: GetFreeMapFile() {
     return freeMapFile;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::GetFreeMap
+// 	Return the bitmap of free sectors.  It stays in memory for as
+//	long as the file system is up; everyone allocating or freeing
+//	sectors uses it, and calls FlushFreeMap once the file headers
+//	and directories that refer to the change are written.
+//----------------------------------------------------------------------
+
+PersistentBitmap *
+FileSystem::GetFreeMap() {
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FlushFreeMap
+// 	Write the changed parts of the free map back to disk.
+//----------------------------------------------------------------------
+
+void
+FileSystem::FlushFreeMap() {
+    freeMap->WriteBack(freeMapFile);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeMapSectors
+// 	Return the most sectors FlushFreeMap may write (all of the free
+//	map's), for a journal transaction to reserve.
+//----------------------------------------------------------------------
+
+int
+FileSystem::FreeMapSectors() {
+    return divRoundUp(FreeMapFileSize, SectorSize);
+}
+
 //getter method for directoryFile
 OpenFile *
 FileSystem:: GetDirectoryFile() {
     return directoryFile;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::GetJournal
+// 	Return the journal, for updates to file headers and the free map
+//	made outside of FileSystem (such as extending a file).
+//----------------------------------------------------------------------
+
+Journal *
+FileSystem::GetJournal() {
+    return journal;
+}
+
 #endif // FILESYS_STUB
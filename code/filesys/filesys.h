@@ -70,14 +70,21 @@ class FileSystem {
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
+class DentryCache;
+class PersistentBitmap;
+class Journal;
+
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, bool useExtents = FALSE);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+					// "useExtents" picks the layout of
+					// the files on a newly formatted disk
 
     bool Create(char *name, int initialSize, int wdSector);  	
 					// Create a file (UNIX creat)
@@ -96,12 +103,30 @@ class FileSystem {
 	int PrintFullPath(int wdSector);
 
 OpenFile *GetFreeMapFile();   // getter method
+PersistentBitmap *GetFreeMap();  // the resident free map
+void FlushFreeMap();             // write its changes to disk
+int FreeMapSectors();            // most sectors that writes
 OpenFile *GetDirectoryFile(); // getter method
+Journal *GetJournal();           // the journal of metadata updates
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   PersistentBitmap *freeMap;		// In-memory copy of the bit map,
+					// kept while Nachos is running
+   int fileLayout;			// Layout of new file headers
+					// (IndexedLayout, ExtentLayout or
+					// TreeLayout)
+   DentryCache *dentries;		// Recent lookups of names in
+					// directories
+   Journal *journal;			// Makes metadata updates atomic
+
+   int ParsePath(char **path, int wdSector);
+					// Find the directory holding the
+					// last component of a path
+   int LookUp(int dirSector, char *name, bool *isDir);
+					// Find a name in a directory
 };
 
 #endif // FILESYS
@@ -0,0 +1,426 @@
+// inode.cc
+//	Routines to manage the table of in-core inodes, shared by all
+//	the OpenFiles of a file.
+//
+//	The table lock is held while a header is read in, so that two
+//	threads opening the same file at once cannot both create an
+//	inode for it.  It is not held while a header is written back:
+//	that begins a journal transaction, which may have to wait for a
+//	group to commit, and threads in that group may want the table.
+
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "main.h"
+#include "inode.h"
+#include "filehdr.h"
+#include "journal.h"
+#include "buffercache.h"
+
+//----------------------------------------------------------------------
+// InodeSector, HashInodeSector
+//	Functions needed by the hash table to find an inode by the
+//	sector of its header.
+//----------------------------------------------------------------------
+
+static int
+InodeSector(Inode *inode)
+{
+    return inode->sector;
+}
+
+static unsigned int
+HashInodeSector(int sector)
+{
+    return (unsigned int) sector;
+}
+
+//----------------------------------------------------------------------
+// NeedsSync
+// 	Return TRUE if the header of "inode" has to be written back, or
+//	some of its bytes have no sectors yet.
+//----------------------------------------------------------------------
+
+static bool
+NeedsSync(Inode *inode)
+{
+    return inode->dirty
+	|| (inode->hdr->FileLength() > inode->hdr->AllocatedLength());
+}
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty table of in-core inodes.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    table = new HashTable<int, Inode *>(InodeSector, HashInodeSector);
+    unused = new List<Inode *>;
+    lock = new Lock("inode table lock");
+    journal = NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the table.  Files still open at this point are not
+//	closed; Nachos is halting, and Flush has written their headers.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    while (!unused->IsEmpty()) {
+	Discard(unused->RemoveFront());
+    }
+    delete unused;
+    delete lock;
+    delete table;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the in-core inode of the file whose header is at "sector",
+//	counting one more OpenFile referring to it.  If the inode is not
+//	cached, create it and read the header in.
+//
+//	"sector" -- the location on disk of the file's header
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::Get(int sector)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    if (table->Find(sector, &inode)) {
+	if (inode->openCount == 0) {
+	    unused->Remove(inode);
+	}
+	kernel->stats->numInodeHits++;
+    } else {
+	inode = new Inode;
+	inode->sector = sector;
+	inode->openCount = 0;
+	inode->hdr = new FileHeader;
+	inode->hdr->FetchFrom(sector);
+	inode->dirty = FALSE;
+	inode->delayed = NULL;
+	inode->rwLock = new RWLock("inode lock");
+	table->Insert(inode);
+	kernel->stats->numInodeMisses++;
+    }
+    inode->openCount++;
+    lock->Release();
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	An OpenFile referring to "inode" has been closed.  When the last
+//	one is, the header is written back if it has changed, and the
+//	inode is kept in the cache; if that makes too many unused ones,
+//	the least recently closed is dropped.
+//
+//	The header is written while we still count as referring to the
+//	inode, without the table lock; someone may open the file and
+//	change it again meanwhile, hence the loop.
+//
+//	"inode" -- the inode no longer referred to
+//----------------------------------------------------------------------
+
+void
+InodeTable::Put(Inode *inode)
+{
+    lock->Acquire();
+    ASSERT(inode->openCount > 0);
+    while ((inode->openCount == 1) && NeedsSync(inode)) {
+	lock->Release();
+	Sync(inode);
+	lock->Acquire();
+    }
+    if (--inode->openCount == 0) {
+	unused->Append(inode);
+	if (unused->NumInList() > InodeCacheSize) {
+	    Discard(unused->RemoveFront());
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::IsOpen
+// 	Return TRUE if some OpenFile refers to the file whose header is
+//	at "sector"; such a file must not be removed.
+//
+//	"sector" -- the location on disk of the file's header
+//----------------------------------------------------------------------
+
+bool
+InodeTable::IsOpen(int sector)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    bool open = table->Find(sector, &inode) && (inode->openCount > 0);
+    lock->Release();
+    return open;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Forget
+// 	The file whose header was at "sector" has been removed; drop its
+//	inode, if cached, so that a file created later at the same sector
+//	does not find the old header.  The file is not open (Remove
+//	checks), so the inode is clean.
+//
+//	"sector" -- the location on disk of the removed file's header
+//----------------------------------------------------------------------
+
+void
+InodeTable::Forget(int sector)
+{
+    Inode *inode;
+
+    lock->Acquire();
+    if (table->Find(sector, &inode)) {
+	ASSERT(inode->openCount == 0);
+	unused->Remove(inode);
+	Discard(inode);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Discard
+// 	De-allocate an inode no OpenFile refers to.  Called with the
+//	table lock held (or from the destructor).
+//
+//	"inode" -- the clean, unused inode to drop
+//----------------------------------------------------------------------
+
+void
+InodeTable::Discard(Inode *inode)
+{
+    ASSERT((inode->openCount == 0) && !NeedsSync(inode));
+    table->Remove(inode->sector);
+    if (inode->delayed != NULL) {
+	delete [] inode->delayed;
+    }
+    delete inode->rwLock;
+    delete inode->hdr;
+    delete inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::MustAllocate
+// 	Return TRUE if the file of "inode" cannot be lengthened to
+//	"length" bytes without allocating more sectors than it has, and
+//	more than DelayedSectors of them; Allocate must be called first.
+//
+//	"inode" -- the inode of the file to lengthen
+//	"length" -- the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+InodeTable::MustAllocate(Inode *inode, int length)
+{
+    return (length - inode->hdr->AllocatedLength()
+		> DelayedSectors * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Allocate
+// 	Allocate sectors for a file that is to become "length" bytes
+//	long: first for the bytes waiting in the inode, then up to
+//	AllocateRun more, stopping DelayedSectors short of "length"
+//	(Extend leaves those to wait).  The free map and the header are
+//	written back together; the header keeps the old length, since
+//	the new bytes are not written yet.
+//
+//	The caller holds the inode's lock to write, inside a journal
+//	transaction of AllocationSectors(inode) sectors; and calls us
+//	again as long as MustAllocate says so.
+//
+//	"inode" -- the inode of the file to lengthen
+//	"length" -- the length the file is going to have, in bytes
+//----------------------------------------------------------------------
+
+void
+InodeTable::Allocate(Inode *inode, int length)
+{
+    FileHeader *hdr = inode->hdr;
+    int fileLength = hdr->FileLength();
+
+    if (!MustAllocate(inode, length)) {
+	return;				// someone else did it
+    }
+    AllocateDelayed(inode);
+    int target = min(length - DelayedSectors * SectorSize,
+			hdr->AllocatedLength() + AllocateRun * SectorSize);
+    if (target > hdr->AllocatedLength()) {
+	ASSERT(hdr->Grow(kernel->fileSystem->GetFreeMap(), target));
+	hdr->SetLength(fileLength);
+	kernel->fileSystem->FlushFreeMap();
+	hdr->WriteBack(inode->sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::AllocationSectors
+// 	Return the most sectors a call of Allocate or Sync writes in its
+//	journal transaction: the metadata for the delayed bytes, and for
+//	a run of AllocateRun sectors, and the free map.
+//
+//	"inode" -- the inode of the file
+//----------------------------------------------------------------------
+
+int
+InodeTable::AllocationSectors(Inode *inode)
+{
+    return inode->hdr->GrowSectors(DelayedSectors)
+		+ inode->hdr->GrowSectors(AllocateRun)
+		+ kernel->fileSystem->FreeMapSectors();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Extend
+// 	Lengthen the file of "inode" to "length" bytes.  The bytes past
+//	the file's last sector are left in the inode, for the caller to
+//	write there; MustAllocate must say they fit.  Only the length has
+//	changed, so the header is written lazily.
+//
+//	The caller holds the inode's lock to write.
+//
+//	"inode" -- the inode of the file to lengthen
+//	"length" -- the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+void
+InodeTable::Extend(Inode *inode, int length)
+{
+    FileHeader *hdr = inode->hdr;
+
+    ASSERT((length > hdr->FileLength()) && !MustAllocate(inode, length));
+    if ((length > hdr->AllocatedLength()) && (inode->delayed == NULL)) {
+	inode->delayed = new char[DelayedSectors * SectorSize];
+	bzero(inode->delayed, DelayedSectors * SectorSize);
+    }
+    hdr->SetLength(length);
+    inode->dirty = TRUE;		// written back on last close
+}
+
+//----------------------------------------------------------------------
+// InodeTable::AllocateDelayed
+// 	Allocate sectors for the bytes of the file of "inode" that are
+//	only in the inode, all at once, and write the bytes to them.
+//	Only the free map and the header are journaled; the bytes are
+//	file data, written around the log -- unless the transaction is
+//	part of an enclosing one (a directory growing inside Create),
+//	whose contents they are.
+//
+//	The caller holds the inode's lock to write, inside a journal
+//	transaction.
+//
+//	"inode" -- the inode whose delayed bytes are to be written
+//----------------------------------------------------------------------
+
+void
+InodeTable::AllocateDelayed(Inode *inode)
+{
+    FileHeader *hdr = inode->hdr;
+    int firstSector = hdr->AllocatedLength() / SectorSize;
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize) - firstSector;
+
+    if (numSectors <= 0) {
+	return;
+    }
+    ASSERT(numSectors <= DelayedSectors);
+    ASSERT(hdr->Grow(kernel->fileSystem->GetFreeMap(), hdr->FileLength()));
+    kernel->fileSystem->FlushFreeMap();
+    hdr->WriteBack(inode->sector);
+    inode->dirty = FALSE;
+
+    int *sectors = new int[numSectors];
+    for (int i = 0; i < numSectors; i++) {
+	sectors[i] = hdr->ByteToSector((firstSector + i) * SectorSize);
+    }
+    kernel->bufferCache->WriteSectors(numSectors, sectors, inode->delayed,
+		(journal != NULL) && journal->IsNested());
+    bzero(inode->delayed, DelayedSectors * SectorSize);
+    delete [] sectors;
+    DEBUG(dbgFile, "Allocated " << numSectors << " delayed sectors of file "
+		<< inode->sector);
+    kernel->stats->numDelayedAllocations++;
+    kernel->stats->numDelayedSectors += numSectors;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Sync
+// 	Allocate sectors for any bytes of the file of "inode" still only
+//	in the inode, and write the header back if it has changed, as a
+//	journal transaction of its own.  The caller refers to the inode,
+//	and holds neither the table lock nor the inode's lock.
+//
+//	"inode" -- the inode whose header is to be written
+//----------------------------------------------------------------------
+
+void
+InodeTable::Sync(Inode *inode)
+{
+    if (!NeedsSync(inode)) {
+	return;
+    }
+    if (journal != NULL) {
+	journal->Begin(AllocationSectors(inode));
+					// always before the inode lock
+    }
+    inode->rwLock->AcquireWrite();
+    AllocateDelayed(inode);
+    if (inode->dirty) {
+	inode->hdr->WriteBack(inode->sector);
+	inode->dirty = FALSE;
+    }
+    inode->rwLock->ReleaseWrite();
+    if (journal != NULL) {
+	journal->End();
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Flush
+// 	Sync every inode that needs it.  Called before the buffer cache
+//	is flushed, when Nachos halts.
+//
+//	Only inodes that OpenFiles refer to can need it; each one is held
+//	(as if opened again) while its header is written, so that it
+//	cannot go away meanwhile.
+//----------------------------------------------------------------------
+
+void
+InodeTable::Flush()
+{
+    List<Inode *> *dirtyList = new List<Inode *>;
+    HashIterator<int, Inode *> *iter;
+
+    lock->Acquire();
+    iter = new HashIterator<int, Inode *>(table);
+    for (; !iter->IsDone(); iter->Next()) {
+	Inode *inode = iter->Item();
+	if (NeedsSync(inode)) {
+	    ASSERT(inode->openCount > 0);
+	    inode->openCount++;
+	    dirtyList->Append(inode);
+	}
+    }
+    delete iter;
+    lock->Release();
+
+    while (!dirtyList->IsEmpty()) {
+	Inode *inode = dirtyList->RemoveFront();
+	Sync(inode);
+	Put(inode);
+    }
+    delete dirtyList;
+}
+
+#endif // FILESYS_STUB
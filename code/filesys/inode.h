@@ -0,0 +1,126 @@
+// inode.h
+//	Data structures for the table of in-core inodes.
+//
+//	Every file that is open has one in-core inode, however many
+//	OpenFile objects refer to it: it holds the file's header (so that
+//	all of them see the same, current, length and block map), the
+//	readers/writer lock that OpenFile::Read and Write synchronize
+//	on, and the number of OpenFiles referring to it.  The table finds
+//	the inode of a file by the sector of its header.
+//
+//	The table is also a cache.  When the last OpenFile of a file is
+//	closed, its inode is kept (up to InodeCacheSize of them, least
+//	recently closed dropped first), so that opening the file again
+//	does not read the header in again.
+//
+//	Changes to the header are not written back right away: the
+//	inode is marked dirty, and the header is written once, when the
+//	last OpenFile is closed, or the file is synced (by Fsync, by
+//	Directory::WriteBack, and for all files when Nachos halts).  So
+//	an inode that no OpenFile refers to is always clean.  The one
+//	exception is allocating sectors: the header is then written at
+//	once, in the same journal transaction as the free map, so that
+//	a crash cannot leave sectors marked in use that no header owns.
+//
+//	Sectors for a growing file are not allocated right away either.
+//	The bytes written past the file's last sector are kept in the
+//	inode, up to DelayedSectors of them; only when they no longer fit,
+//	or the header is written back, are sectors allocated for all of
+//	them at once -- one run of the free map, one update of the
+//	metadata -- and the bytes written to them.  The header on disk
+//	never claims bytes that have no sectors.
+//
+//	A long append cannot wait that way: its sectors are allocated
+//	first, AllocateRun at a time, each run in a journal transaction
+//	of its own, so that no transaction outgrows the log.  Then the
+//	file is lengthened, with no more than DelayedSectors left to
+//	allocate.
+
+#include "copyright.h"
+
+#ifndef INODE_H
+#define INODE_H
+
+#include "hash.h"
+#include "list.h"
+#include "synch.h"
+
+#define InodeCacheSize	32		// Inodes kept after their file
+					// is closed
+#define DelayedSectors	8		// Most sectors' worth of a file
+					// kept in its inode, unallocated
+#define AllocateRun	32		// Most sectors allocated ahead of
+					// an append in one transaction
+
+class FileHeader;
+class Journal;
+
+// The following class defines an in-core inode.
+//
+// Internal data structures kept public so that OpenFile can get at
+// them directly.
+
+class Inode {
+  public:
+    int sector;				// Sector of the file's header
+    int openCount;			// # of OpenFiles referring to it
+    FileHeader *hdr;			// The file's header
+    bool dirty;				// Has hdr changed since it was
+					// last written back?
+    char *delayed;			// The bytes of the file past its
+					// last allocated sector (see
+					// FileHeader::AllocatedLength), or
+					// NULL if there have never been any
+    RWLock *rwLock;			// Held to read by Read, and to
+					// write by Write (and to extend
+					// the file)
+};
+
+// The following class defines the table of in-core inodes.  Get
+// returns the inode for a header sector, reading the header in if it
+// is not cached; Put is called when an OpenFile is closed, and the
+// inode joins the list of unused ones with the last one.
+
+class InodeTable {
+  public:
+    InodeTable();			// Initialize an empty table
+    ~InodeTable();
+
+    void SetJournal(Journal *j) { journal = j; }
+					// Write headers back inside
+					// transactions of "j"
+    Inode *Get(int sector);		// The inode for "sector", with its
+					// open count incremented
+    void Put(Inode *inode);		// Done with "inode"
+    bool IsOpen(int sector);		// Is the file open at all?
+    void Forget(int sector);		// The file has been removed
+
+    bool MustAllocate(Inode *inode, int length);
+					// Too many bytes to delay, for the
+					// file to become "length" long?
+    void Allocate(Inode *inode, int length);
+					// Allocate a run of sectors toward
+					// that length
+    int AllocationSectors(Inode *inode);// Most sectors Allocate or Sync
+					// journal
+    void Extend(Inode *inode, int length);
+					// Lengthen the file, delaying
+					// allocation
+    void Sync(Inode *inode);		// Allocate delayed bytes, and write
+					// the header back, if dirty
+    void Flush();			// ... for every inode
+
+  private:
+    HashTable<int, Inode *> *table;	// Map header sector -> inode
+    List<Inode *> *unused;		// Cached inodes no OpenFile refers
+					// to, least recently closed first
+    Lock *lock;				// Protects the table, the list and
+					// the open counts
+    Journal *journal;			// Or NULL, before the file system
+					// is mounted
+
+    void Discard(Inode *inode);		// Drop an unused inode
+    void AllocateDelayed(Inode *inode);	// Give the delayed bytes sectors
+};
+
+#endif // INODE_H
@@ -0,0 +1,397 @@
+// journal.cc
+//	Routines to journal metadata updates, so that file system
+//	operations are all-or-nothing even if Nachos stops in the middle
+//	of one.
+//
+//	The life of a group of transactions:
+//	   Begin/End -- each transaction writes its sectors to the buffer
+//		cache, which pins them and reports them with AddSector
+//	   CommitGroup -- once no transaction is running, write the
+//		previous group to its place on disk (it has to be there
+//		before its log is overwritten), then write the current
+//		group's sectors to the log, after a header with their home
+//		sectors and a checksum; then unpin them, so that the cache
+//		can write them home in its own time
+//	   Recover -- at mount, if the log holds a valid group, write it
+//		home again.  This is harmless if it was already there: a
+//		logged sector is only ever rewritten by a later group,
+//		which would have replaced the log.
+//
+//	The log is written and replayed directly through the synchronous
+//	disk; everything else goes through the buffer cache.
+
+#include "copyright.h"
+#include "main.h"
+#include "journal.h"
+#include "buffercache.h"
+#include "synchdisk.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  When formatting, write an empty log
+//	header, which also marks the disk as having a log (the caller
+//	marks the log's sectors as in use).  Otherwise, look for the log
+//	and replay it; disks formatted without one work as before, just
+//	without journaling.
+//
+//	Must be called before anything else reads the file system.
+//
+//	"format" -- is the disk being formatted?
+//----------------------------------------------------------------------
+
+Journal::Journal(bool format)
+{
+    capacity = min(JournalMaxSectors, kernel->bufferCache->NumBuffers() / 2);
+					// leave the cache some unpinned buffers
+    ASSERT(capacity >= JournalReserve);	// else -cache is too small
+    sequence = 0;
+    lock = new Lock("journal lock");
+    groupClosed = new Condition("journal group closed");
+    numActive = 0;
+    numReserved = 0;
+    committing = FALSE;
+    commitWanted = FALSE;
+    numLogged = 0;
+    logged = new int[JournalMaxSectors];
+    numOps = 0;
+    numPrevious = 0;
+    previous = new int[JournalMaxSectors];
+    previousData = new char[JournalMaxSectors * SectorSize];
+
+    if (format) {
+	JournalHeader header;
+
+	bzero((char *) &header, sizeof(header));
+	header.magic = JournalMagic;
+	header.checksum = Checksum(&header, NULL);
+	kernel->synchDisk->WriteSector(JournalSector, (char *) &header);
+	enabled = TRUE;
+    } else {
+	Recover();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  The buffer cache has committed the
+//	last group when it was flushed.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete lock;
+    delete groupClosed;
+    delete [] logged;
+    delete [] previous;
+    delete [] previousData;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checksum
+// 	Compute the checksum of a log header and the sectors it
+//	describes.
+//
+//	"header" -- the log header (its checksum field is left out)
+//	"data" -- the logged sectors, one after another
+//----------------------------------------------------------------------
+
+unsigned int
+Journal::Checksum(JournalHeader *header, char *data)
+{
+    unsigned int sum = header->magic;
+    unsigned int *words;
+    int i;
+
+    sum = (sum << 5) + sum + header->sequence;
+    sum = (sum << 5) + sum + header->count;
+    for (i = 0; i < header->count; i++) {
+	sum = (sum << 5) + sum + header->sectors[i];
+    }
+    words = (unsigned int *) data;
+    for (i = 0; i < header->count * (int) (SectorSize / sizeof(int)); i++) {
+	sum = (sum << 5) + sum + words[i];
+    }
+    return sum;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Read the log header.  If the disk has no log, disable the
+//	journal.  If the log holds a group whose checksum is right,
+//	write its sectors to where they belong.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    JournalHeader header;
+
+    kernel->synchDisk->ReadSector(JournalSector, (char *) &header);
+    enabled = (header.magic == JournalMagic);
+    if (!enabled) {
+	DEBUG(dbgFile, "No journal on this disk.");
+	return;
+    }
+    sequence = header.sequence;
+    if ((header.count <= 0) || (header.count > JournalMaxSectors)) {
+	return;				// nothing logged
+    }
+
+    int *logSectors = new int[header.count];
+    char *data = new char[header.count * SectorSize];
+    char **buffers = new char *[header.count];
+    for (int i = 0; i < header.count; i++) {
+	logSectors[i] = JournalSector + 1 + i;
+	buffers[i] = &data[i * SectorSize];
+    }
+    kernel->synchDisk->ReadSectors(header.count, logSectors, buffers);
+    if (Checksum(&header, data) == header.checksum) {
+	DEBUG(dbgFile, "Replaying journal group " << header.sequence
+		<< ", " << header.count << " sectors.");
+	kernel->synchDisk->WriteSectors(header.count, header.sectors, buffers);
+	kernel->stats->numJournalReplays++;
+    } else {
+	DEBUG(dbgFile, "Journal group " << header.sequence
+		<< " is incomplete; ignored.");
+    }
+    delete [] buffers;
+    delete [] data;
+    delete [] logSectors;
+}
+
+//----------------------------------------------------------------------
+// Journal::InTransaction
+// 	Return TRUE if the current thread is inside a transaction, so
+//	that the sectors it writes belong to the current group.
+//----------------------------------------------------------------------
+
+bool
+Journal::InTransaction()
+{
+    return enabled && (kernel->currentThread->journalDepth > 0);
+}
+
+//----------------------------------------------------------------------
+// Journal::IsNested
+// 	Return TRUE if the current thread's transaction was begun inside
+//	another one -- a file system operation, say, writing a directory
+//	back -- so that the data it writes belongs to that operation.
+//----------------------------------------------------------------------
+
+bool
+Journal::IsNested()
+{
+    return enabled && (kernel->currentThread->journalDepth > 1);
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction for the current thread.  A transaction begun
+//	inside another one is just part of it, and its sectors are part
+//	of the enclosing reservation.
+//
+//	The group must have room for every sector the transactions
+//	running may still write, and for ours.  If it has not, and other
+//	transactions are running, we wait for them to end; once none
+//	is, the group is committed if need be, by the last one to end or
+//	by us.  Counting the sectors the running transactions have
+//	already logged against their reservations as well is
+//	pessimistic, but simple.
+//
+//	"numSectors" -- the most sectors the transaction writes
+//----------------------------------------------------------------------
+
+void
+Journal::Begin(int numSectors)
+{
+    if (!enabled) {
+	return;
+    }
+    if (kernel->currentThread->journalDepth++ > 0) {
+	return;				// nested
+    }
+    ASSERT(numSectors <= capacity);
+
+    lock->Acquire();
+    while (committing || commitWanted || ((numActive > 0) &&
+	    (numLogged + numReserved + numSectors > capacity))) {
+	groupClosed->Wait(lock);
+    }
+    if (numLogged + numSectors > capacity) {
+	CommitGroup();
+    }
+    numActive++;
+    numReserved += numSectors;
+    kernel->currentThread->journalReserved = numSectors;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CanReserve
+// 	Return TRUE if a transaction may write "numSectors" sectors: an
+//	operation that would write more must not be done at all.
+//----------------------------------------------------------------------
+
+bool
+Journal::CanReserve(int numSectors)
+{
+    return !enabled || (numSectors <= capacity);
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	Finish the current thread's transaction, giving back its
+//	reservation.  If it was the last one running, commit the group
+//	if it is nearly full.  Either way, waiting transactions may now
+//	fit.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    if (!enabled) {
+	return;
+    }
+    ASSERT(kernel->currentThread->journalDepth > 0);
+    if (--kernel->currentThread->journalDepth > 0) {
+	return;				// nested
+    }
+
+    lock->Acquire();
+    numActive--;
+    numReserved -= kernel->currentThread->journalReserved;
+    numOps++;
+    if ((numActive == 0) && (numLogged + JournalReserve > capacity)) {
+	CommitGroup();
+    }
+    groupClosed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::AddSector
+// 	Called by the buffer cache when a transaction writes a sector
+//	not already in the group; the sector must stay pinned in the
+//	cache until the group is logged.  The transaction reserved room
+//	for it in Begin.
+//
+//	The buffer cache lock is held, so calls are serialized; and
+//	since a transaction is running, no group is being committed.
+//
+//	"sector" -- the sector written
+//----------------------------------------------------------------------
+
+void
+Journal::AddSector(int sector)
+{
+    ASSERT(!committing);
+    ASSERT(numLogged < capacity);	// someone wrote more than reserved
+    logged[numLogged++] = sector;
+}
+
+//----------------------------------------------------------------------
+// Journal::WaitForCommit
+// 	Wait until no group is being committed.  Called by the buffer
+//	cache, without its lock held, before a thread outside any
+//	transaction changes a sector of the group being logged.
+//----------------------------------------------------------------------
+
+void
+Journal::WaitForCommit()
+{
+    lock->Acquire();
+    while (committing) {
+	groupClosed->Wait(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Commit the current group right away: stop new transactions from
+//	starting, wait for the running ones to end, and log the group.
+//	Used when the buffer cache is flushed.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    if (!enabled) {
+	return;
+    }
+    ASSERT(kernel->currentThread->journalDepth == 0);
+
+    lock->Acquire();
+    while (committing || commitWanted) {
+	groupClosed->Wait(lock);
+    }
+    commitWanted = TRUE;
+    while (numActive > 0) {
+	groupClosed->Wait(lock);
+    }
+    CommitGroup();
+    commitWanted = FALSE;
+    groupClosed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitGroup
+// 	Write the current group to the log, and hand its sectors back to
+//	the buffer cache.  The group's contents are saved, so that the
+//	next commit can write them home even if they have been changed
+//	again (and pinned) since.
+//
+//	Must be called with the journal lock held and no transaction
+//	running.  Threads outside any transaction wait (in the buffer
+//	cache) before changing one of the group's sectors meanwhile.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitGroup()
+{
+    ASSERT(lock->IsHeldByCurrentThread() && (numActive == 0));
+    if (numLogged == 0) {
+	return;
+    }
+    committing = TRUE;
+
+    // the previous group's log is about to be overwritten
+    kernel->bufferCache->Checkpoint(numPrevious, previous, previousData);
+
+    JournalHeader header;
+    int logSectors[JournalSectors];
+    char *buffers[JournalSectors];
+
+    bzero((char *) &header, sizeof(header));
+    header.magic = JournalMagic;
+    header.sequence = ++sequence;
+    header.count = numLogged;
+    for (int i = 0; i < numLogged; i++) {
+	header.sectors[i] = logged[i];
+    }
+    kernel->bufferCache->ReadSectors(numLogged, logged, previousData);
+    header.checksum = Checksum(&header, previousData);
+
+    logSectors[0] = JournalSector;
+    buffers[0] = (char *) &header;
+    for (int i = 0; i < numLogged; i++) {
+	logSectors[i + 1] = JournalSector + 1 + i;
+	buffers[i + 1] = &previousData[i * SectorSize];
+    }
+    kernel->synchDisk->WriteSectors(numLogged + 1, logSectors, buffers);
+    DEBUG(dbgFile, "Committed journal group " << sequence << ": "
+	    << numOps << " transactions, " << numLogged << " sectors.");
+
+    kernel->bufferCache->Unpin(numLogged, logged);
+    kernel->stats->numJournalCommits++;
+    kernel->stats->numJournalOps += numOps;
+    kernel->stats->numJournalSectors += numLogged;
+
+    numPrevious = numLogged;
+    bcopy((char *) logged, (char *) previous, numLogged * sizeof(int));
+    numLogged = 0;
+    numOps = 0;
+    committing = FALSE;
+    groupClosed->Broadcast(lock);
+}
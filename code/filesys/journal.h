@@ -0,0 +1,121 @@
+// journal.h
+//	Data structures for the write-ahead journal of metadata updates.
+//
+//	A file system operation such as Create writes several sectors --
+//	the new file header, the directory, the bitmap -- and if Nachos
+//	stops between two of those writes, the disk is left inconsistent.
+//	To prevent this, metadata updates are grouped into transactions.
+//	The sectors a transaction writes are held ("pinned") in the
+//	buffer cache, and are not written to their place on disk until
+//	they have first been written, all together, to a log at a fixed
+//	place on the disk.  If Nachos stops before that, none of them
+//	reach the disk; if it stops after, the log is replayed when the
+//	file system is next mounted.
+//
+//	Transactions are not committed one at a time: the log holds a
+//	whole group of them, collected until the log is nearly full, or
+//	until the cache is flushed (by Fsync, and when Nachos halts).
+//	Each group is written with one sequential disk request, and a
+//	sector written by many operations of the group -- the directory,
+//	or the bitmap -- is logged only once.
+//
+//	A group is only ever committed with no transaction running, so
+//	that it holds whole transactions.  Each transaction therefore
+//	says, when it begins, the most sectors it may write ("reserves"
+//	them), and waits until the group has room for them all.  File
+//	system operations too big for any group -- a directory grown
+//	past what the log can hold -- are refused; appends allocate
+//	their sectors a bounded run at a time (see inode.h).
+//
+//	Only metadata is journaled.  A transaction belongs to the thread
+//	that began it: the buffer cache pins the sectors written by
+//	threads inside a transaction, and no others.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+
+#define JournalSector		2	// The log header; the logged
+					// sectors follow it
+#define JournalMaxSectors	((int) (SectorSize / sizeof(int)) - 4)
+					// Most sectors in one group (28)
+#define JournalSectors		(1 + JournalMaxSectors)
+					// Size of the log on disk
+#define JournalReserve		16	// Room a group must have for the
+					// fixed-size transactions; the
+					// cache holds two groups' worth
+#define JournalMagic		0x4a726e6c
+
+// The following class defines the log header, which occupies the
+// first sector of the log.  A group is valid only if the checksum
+// over the header and the logged sectors matches; otherwise the log
+// was being written when Nachos stopped.
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic, if the disk has a log
+    int sequence;			// Number of the logged group
+    int count;				// Number of sectors logged
+    unsigned int checksum;		// Of all the above, and the data
+    int sectors[JournalMaxSectors];	// Where each logged sector belongs
+};
+
+// The following class defines the journal.
+//
+// While one group is being committed, no transaction may begin.  The
+// sectors of a committed group are written to their place on disk by
+// the buffer cache, as for any dirty sector; but they must be there
+// before the next group overwrites the log, so each commit starts by
+// writing back the previous group (a "checkpoint").
+
+class Journal {
+  public:
+    Journal(bool format);		// Set up the log if "format", else
+					// replay it
+    ~Journal();
+
+    bool IsEnabled() { return enabled; }// Does the disk have a log?
+    void Begin(int numSectors);		// Start a transaction for the
+					// current thread, writing at most
+					// "numSectors" (they may nest)
+    bool CanReserve(int numSectors);	// Could a transaction write that
+					// many?
+    void End();				// Finish it
+    bool InTransaction();		// Is the current thread in one?
+    bool IsNested();			// ... begun inside another one?
+    bool IsCommitting() { return committing; }
+					// Is a group being logged?
+    void AddSector(int sector);		// A transaction wrote "sector"
+    void WaitForCommit();		// Wait for the commit under way
+    void Commit();			// Commit the current group now
+
+  private:
+    bool enabled;			// FALSE for disks formatted before
+					// the journal existed
+    int capacity;			// Most sectors in a group
+    int sequence;			// Number of the last logged group
+    Lock *lock;				// Protects the fields below
+    Condition *groupClosed;		// Signalled when a commit is done,
+					// or the last transaction ends
+    int numActive;			// Transactions running
+    int numReserved;			// Sectors they may still write
+    bool committing;			// Is a group being committed?
+    bool commitWanted;			// Is Commit waiting for a group to
+					// finish?
+    int numLogged;			// Sectors in the current group
+    int *logged;			// ... and which ones
+    int numOps;				// Transactions in the current group
+    int numPrevious;			// Sectors in the previous group
+    int *previous;			// ... which ones,
+    char *previousData;			// ... and what was logged for them
+
+    void CommitGroup();			// Log the current group
+    void Recover();			// Replay the log, if it is valid
+    static unsigned int Checksum(JournalHeader *header, char *data);
+};
+
+#endif // JOURNAL_H
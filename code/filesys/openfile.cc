@@ -5,7 +5,7 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open, in the file's in-core inode.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,12 +16,14 @@
 #include "main.h"
 #include "filehdr.h"
 #include "openfile.h"
-#include "synchdisk.h"
+#include "buffercache.h"
+#include "journal.h"
+#include "inode.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
-// 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+// 	Open a Nachos file for reading and writing.  The file header is
+//	in memory, in the file's in-core inode, while the file is open.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
@@ -29,25 +31,13 @@
 OpenFile::OpenFile(int sector)
 { 
     DEBUG('f',"start open file sectornum :"<< sector) 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = kernel->inodeTable->Get(sector);
+    hdr = inode->hdr;
     seekPosition = 0;
     hdrSector = sector;
-    
-    
-    if(kernel->OpenFileCount->find(hdrSector) == kernel->OpenFileCount->end())
-    kernel->OpenFileCount->operator[](hdrSector)=0;
-    else
-    {
-        kernel->OpenFileCount->operator[](hdrSector)=kernel->OpenFileCount->operator[](hdrSector)+1;
-    }
-
-    if(kernel->readerCount->find(hdrSector) == kernel->readerCount->end())
-    kernel->readerCount->operator[](sector)=0;
-    if(kernel->semaphoreWrite->find(hdrSector) == kernel->semaphoreWrite->end())
-    kernel->semaphoreWrite->operator[](sector) = new Semaphore("write",1);
-    if(kernel->semaphoreRead->find(hdrSector) == kernel->semaphoreRead->end())
-    kernel->semaphoreRead->operator[](sector) = new Semaphore("read",1);
+    lastReadEnd = 0;			// reading from the start counts
+    readAheadWindow = 0;		// as sequential
+    readAheadNext = 0;
     DEBUG('f',"open file successfully\n");
 }
 
@@ -58,8 +48,21 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
-    kernel-> OpenFileCount->operator[](hdrSector) = kernel->OpenFileCount->operator[](hdrSector)-1;
+    kernel->inodeTable->Put(inode);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Sync
+// 	Allocate sectors for any bytes of the file still waiting in its
+//	inode, and write the file header back, if it has changed since it
+//	was read in or last written.  Otherwise that happens when the
+//	last OpenFile for the file is closed.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Sync()
+{
+    kernel->inodeTable->Sync(inode);
 }
 
 //----------------------------------------------------------------------
@@ -84,6 +87,15 @@ OpenFile::Seek(int position)
 //
 //	Implemented using the more primitive ReadAt/WriteAt.
 //
+//	Sectors for a long append are allocated first, a run at a time,
+//	each run a journal transaction of its own that writes the free
+//	map and the header back together.  The inode lock is let go
+//	between runs, since a transaction may have to wait to begin.
+//	The new length itself is left in the inode, and written when the
+//	file is closed or synced.  File data is not journaled -- unless
+//	the Write is part of a file system operation's own transaction,
+//	as when a directory is written back.
+//
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
@@ -93,47 +105,102 @@ int
 OpenFile::Read(char *into, int numBytes)
 {
     DEBUG('f',"reading file\n");
-    DEBUG('f',"semaphore Key: hdrSector:" << hdrSector);
-   kernel->semaphoreRead->operator[](hdrSector)->P();
-   if(kernel->readerCount->find(hdrSector) != kernel->readerCount->end())
-        kernel->readerCount->operator[](hdrSector)= kernel->readerCount->operator[](hdrSector)+1;
-   if(kernel->readerCount->operator[](hdrSector)==1)
-   kernel->semaphoreWrite->operator[](hdrSector)->P();
-   kernel->semaphoreRead->operator[](hdrSector)->V();
-
-   int result = ReadAt(into, numBytes, seekPosition);
-   seekPosition += result;
-
-   kernel->semaphoreRead->operator[](hdrSector)->P();
-   if(kernel->readerCount->find(hdrSector) != kernel->readerCount->end())
-        kernel->readerCount->operator[](hdrSector)= kernel->readerCount->operator[](hdrSector)-1;
-    if(kernel->readerCount->operator[](hdrSector)==0)
-        kernel->semaphoreWrite->operator[](hdrSector)->V();
-   kernel->semaphoreRead->operator[](hdrSector)->V();
-   return result;
+    inode->rwLock->AcquireRead();
+    int result = ReadAtLocked(into, numBytes, seekPosition);
+    seekPosition += result;
+    if (result > 0)
+        ReadAhead(seekPosition - result, seekPosition);
+    inode->rwLock->ReleaseRead();
+    return result;
 }
 
 int
 OpenFile::Write(char *into, int numBytes)
 {    
+    Journal *journal = kernel->fileSystem->GetJournal();
+    int end = seekPosition + numBytes;
+
     DEBUG('f',"start writing to " << into);
+    while (kernel->inodeTable->MustAllocate(inode, end)) {
+        journal->Begin(kernel->inodeTable->AllocationSectors(inode));
+                                        // always before the inode lock
+        inode->rwLock->AcquireWrite();
+        kernel->inodeTable->Allocate(inode, end);
+        inode->rwLock->ReleaseWrite();
+        journal->End();
+    }
+    inode->rwLock->AcquireWrite();
     //extend the file if necessary
-    if(seekPosition + numBytes > hdr->FileLength()){
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
-        freeMap->FetchFrom(kernel->fileSystem->GetFreeMapFile());
-        ASSERT(hdr->Allocate(freeMap,numBytes));
-        hdr->WriteBack(hdrSector);
-        freeMap->WriteBack(kernel->fileSystem->GetFreeMapFile());
-        delete freeMap;
+    if(end > hdr->FileLength())
+        kernel->inodeTable->Extend(inode, end);
+    int result = WriteAtLocked(into, numBytes, seekPosition);
+    seekPosition += result;
+    inode->rwLock->ReleaseWrite();
+    DEBUG('f',"writing done");
+    return result;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Sequential read-ahead.  Called after each Read; if the Read
+//	started where the previous one stopped, the file is being read
+//	sequentially, so ask the buffer cache to prefetch the next
+//	readAheadWindow sectors while the caller works on this chunk.
+//	The window doubles with each sequential Read, up to MaxReadAhead,
+//	and is dropped altogether as soon as a Read is not sequential.
+//
+//	"start", "end" -- the bytes just read were [start, end)
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int start, int end)
+{
+    if (start != lastReadEnd) {		// a seek; stop reading ahead
+	readAheadWindow = 0;
+	readAheadNext = 0;
+    } else if (readAheadWindow == 0) {
+	readAheadWindow = MinReadAhead;
+    } else {
+	readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+    }
+    lastReadEnd = end;
+    if (readAheadWindow == 0)
+	return;
+
+    int nextSector = divRoundUp(end, SectorSize);	// first one not
+							// yet read
+    int first = max(readAheadNext, nextSector);
+    int last = min(nextSector + readAheadWindow,
+			divRoundUp(min(hdr->FileLength(), hdr->AllocatedLength()),
+				SectorSize));	// delayed bytes have no sectors
+    if (first >= last)
+	return;
+
+    int *sectors = new int[last - first];
+    for (int i = first; i < last; i++)
+	sectors[i - first] = hdr->ByteToSector(i * SectorSize);
+    kernel->bufferCache->Prefetch(last - first, sectors);
+    readAheadNext = last;
+    delete [] sectors;
+}
+
+//----------------------------------------------------------------------
+// BounceThread
+// 	Return the current thread, with its bounce buffer allocated.
+//	A thread does one transfer at a time, so one buffer is enough,
+//	and it is kept until the thread is destroyed.
+//----------------------------------------------------------------------
+
+static Thread *
+BounceThread()
+{
+    Thread *thread = kernel->currentThread;
+
+    if (thread->bounceData == NULL) {
+	thread->bounceData = new char[SectorSize];
+	thread->bounceSectors = new int[BounceSectors];
     }
-    kernel->semaphoreWrite->operator[](hdrSector)->P();
-    DEBUG('f',"entered critical aera\n");
-   int result = WriteAt(into, numBytes, seekPosition);
-   seekPosition += result;
-
-   kernel->semaphoreWrite->operator[](hdrSector)->V();
-   DEBUG('f',"writing done");
-   return result;
+    return thread;
 }
 
 //----------------------------------------------------------------------
@@ -155,6 +222,18 @@ OpenFile::Write(char *into, int numBytes)
 //	   in the data that will be modified, and write back all the full
 //	   or partial sectors that are part of the request.
 //
+//	Whole sectors are transferred straight between the caller's
+//	buffer and the buffer cache, up to BounceSectors of them as one
+//	list, so runs of consecutive sectors reach the disk together.
+//	Only a partial sector at either end goes through a copy, in the
+//	current thread's bounce buffer; nothing is allocated per call.
+//	Bytes past the file's last allocated sector are not on disk at
+//	all, but in the inode (see inode.h), and are copied there.
+//
+//	ReadAt holds the inode's lock to read, and WriteAt to write; the
+//	work is done by ReadAtLocked and WriteAtLocked, which Read and
+//	Write call with the lock already held.
+//
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
@@ -164,10 +243,26 @@ OpenFile::Write(char *into, int numBytes)
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
+{
+    inode->rwLock->AcquireRead();
+    int result = ReadAtLocked(into, numBytes, position);
+    inode->rwLock->ReleaseRead();
+    return result;
+}
+
+int
+OpenFile::WriteAt(char *from, int numBytes, int position)
+{
+    inode->rwLock->AcquireWrite();
+    int result = WriteAtLocked(from, numBytes, position);
+    inode->rwLock->ReleaseWrite();
+    return result;
+}
+
+int
+OpenFile::ReadAtLocked(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -175,29 +270,45 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    int onDisk = hdr->AllocatedLength() - position;
+    if (onDisk < numBytes) {		// the rest is in the inode
+	int start = max(position, hdr->AllocatedLength());
+	bcopy(&inode->delayed[start - hdr->AllocatedLength()],
+		&into[start - position], position + numBytes - start);
+	if (onDisk <= 0)
+	    return numBytes;
+    } else {
+	onDisk = numBytes;
+    }
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    Thread *thread = BounceThread();
+    int done = 0;
+    while (done < onDisk) {
+	int offset = (position + done) % SectorSize;
+	int count = min(SectorSize - offset, onDisk - done);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+	if (count < SectorSize) {	// part of a sector: bounce it
+	    kernel->bufferCache->ReadSector(hdr->ByteToSector(position + done),
+					thread->bounceData);
+	    bcopy(&thread->bounceData[offset], &into[done], count);
+	} else {			// whole sectors: no copy of ours
+	    int numSectors = min((onDisk - done) / SectorSize, BounceSectors);
+	    for (int i = 0; i < numSectors; i++)
+		thread->bounceSectors[i] =
+			hdr->ByteToSector(position + done + i * SectorSize);
+	    kernel->bufferCache->ReadSectors(numSectors, thread->bounceSectors,
+					&into[done]);
+	    count = numSectors * SectorSize;
+	}
+	done += count;
+    }
     return numBytes;
 }
 
 int
-OpenFile::WriteAt(char *from, int numBytes, int position)
+OpenFile::WriteAtLocked(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
 	return 0;				// check request
@@ -205,30 +316,41 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-   
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    int onDisk = hdr->AllocatedLength() - position;
+    if (onDisk < numBytes) {		// the rest goes in the inode
+	int start = max(position, hdr->AllocatedLength());
+	bcopy(&from[start - position],
+		&inode->delayed[start - hdr->AllocatedLength()],
+		position + numBytes - start);
+	if (onDisk <= 0)
+	    return numBytes;
+    } else {
+	onDisk = numBytes;
+    }
+
+    Thread *thread = BounceThread();
+    int done = 0;
+    while (done < onDisk) {
+	int offset = (position + done) % SectorSize;
+	int count = min(SectorSize - offset, onDisk - done);
+
+	if (count < SectorSize) {	// part of a sector: read, modify,
+					// and write it back
+	    int sector = hdr->ByteToSector(position + done);
+	    kernel->bufferCache->ReadSector(sector, thread->bounceData);
+	    bcopy(&from[done], &thread->bounceData[offset], count);
+	    kernel->bufferCache->WriteSector(sector, thread->bounceData);
+	} else {			// whole sectors: no copy of ours
+	    int numSectors = min((onDisk - done) / SectorSize, BounceSectors);
+	    for (int i = 0; i < numSectors; i++)
+		thread->bounceSectors[i] =
+			hdr->ByteToSector(position + done + i * SectorSize);
+	    kernel->bufferCache->WriteSectors(numSectors, thread->bounceSectors,
+					&from[done]);
+	    count = numSectors * SectorSize;
+	}
+	done += count;
+    }
     return numBytes;
 }
 
@@ -243,4 +365,21 @@ OpenFile::Length()
     return hdr->FileLength(); 
 }
 
+//----------------------------------------------------------------------
+// OpenFile::GrowSectors
+// 	Return the most sectors of metadata -- the header, fileblocks
+//	and free map -- that lengthening the file to "newLength" bytes
+//	writes, for a journal transaction to reserve.
+//----------------------------------------------------------------------
+
+int
+OpenFile::GrowSectors(int newLength)
+{
+    int needSectors = divRoundUp(newLength, SectorSize)
+			- hdr->AllocatedLength() / SectorSize;
+
+    return hdr->GrowSectors(needSectors)
+		+ kernel->fileSystem->FreeMapSectors();
+}
+
 #endif //FILESYS_STUB
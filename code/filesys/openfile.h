@@ -9,9 +9,9 @@
 //
 //	The other is the "real" implementation, that turns these
 //	operations into read and write disk sector requests. 
-//	In this baseline implementation of the file system, we don't 
-//	worry about concurrent accesses to the file system
-//	by different threads.
+//	All the OpenFiles of a file share its in-core inode (see
+//	inode.h), and with it the file header and a readers/writer lock:
+//	reads of a file proceed in parallel, writes one at a time.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -51,6 +51,7 @@ class OpenFile {
 		currentOffset += numWritten;
 		return numWritten;
 		}
+    void Seek(int position) { currentOffset = position; }
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
     
@@ -60,7 +61,15 @@ class OpenFile {
 };
 
 #else // FILESYS
+#define BounceSectors	32	// Most whole sectors a transfer hands the
+				// buffer cache at once
+
 class FileHeader;
+class Inode;
+
+#define MinReadAhead	2	// read-ahead window after the first
+				// sequential read, in sectors
+#define MaxReadAhead	16	// the window doubles up to this size
 
 class OpenFile {
   public:
@@ -70,6 +79,8 @@ class OpenFile {
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
+    void Sync();			// Write the header back now, rather
+					// than when the file is closed
 
     int Read(char *into, int numBytes); // Read/write bytes from the file,
 					// starting at the implicit position.
@@ -86,11 +97,28 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int GrowSectors(int newLength);	// Most sectors of metadata that
+					// lengthening it writes
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    Inode *inode;			// In-core inode for this file
+    FileHeader *hdr;			// Header for this file (the inode's)
     int seekPosition;			// Current position within the file
 	int hdrSector;
+
+    int ReadAtLocked(char *into, int numBytes, int position);
+    int WriteAtLocked(char *from, int numBytes, int position);
+					// ReadAt/WriteAt, for callers already
+					// holding the inode's lock
+
+    int lastReadEnd;			// Where the last Read stopped
+    int readAheadWindow;		// # sectors to keep prefetched ahead
+					// of sequential Reads; 0 after a seek
+    int readAheadNext;			// First sector (within the file)
+					// not yet asked to be prefetched
+
+    void ReadAhead(int start, int end);	// Prefetch after a Read of
+					// bytes [start, end)
 };
 
 #endif // FILESYS
@@ -8,6 +8,7 @@
 
 #include "copyright.h"
 #include "pbitmap.h"
+#include "disk.h"
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -21,6 +22,8 @@
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    onDisk = new unsigned int[numWords];
+    onDiskValid = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +43,8 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
     // map found in the file
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    onDisk = new unsigned int[numWords];
+    FetchFrom(file);
 }
 
 //----------------------------------------------------------------------
@@ -50,6 +54,7 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete [] onDisk;
 }
 
 //----------------------------------------------------------------------
@@ -63,11 +68,17 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    bcopy((char *)map, (char *)onDisk, numWords * sizeof(unsigned));
+    onDiskValid = TRUE;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
+//	Only the sectors of the file whose bits have changed since the
+//	last FetchFrom or WriteBack are written; the first time, though,
+//	all of them are.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -75,5 +86,16 @@ PersistentBitmap::FetchFrom(OpenFile *file)
 void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int numBytes = numWords * sizeof(unsigned);
+    char *current = (char *)map;
+    char *old = (char *)onDisk;
+
+    for (int offset = 0; offset < numBytes; offset += SectorSize) {
+	int length = min(SectorSize, numBytes - offset);
+	if (onDiskValid && !memcmp(current + offset, old + offset, length))
+	    continue;			// this sector hasn't changed
+	file->WriteAt(current + offset, length, offset);
+	bcopy(current + offset, old + offset, length);
+    }
+    onDiskValid = TRUE;
 }
@@ -6,6 +6,10 @@
 //    when it is created, or it can be initialized later using
 //    the FetchFrom method
 //
+//    The bitmap remembers what it last read from or wrote to disk,
+//    so that WriteBack only writes the sectors of the file that
+//    have changed since.
+//
 // Copyright (c) 1992,1993,1995 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -29,7 +33,14 @@ class PersistentBitmap : public Bitmap {
     ~PersistentBitmap(); 			// deallocate bitmap
 
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
-    void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void WriteBack(OpenFile *file); 	// write changed parts of the bitmap
+					// to disk 
+
+  private:
+    unsigned int *onDisk;		// contents as of the last FetchFrom
+					// or WriteBack
+    bool onDiskValid;			// is "onDisk" meaningful? (not until
+					// the first FetchFrom or WriteBack)
 };
 
 #endif // PBITMAP_H
@@ -5,10 +5,23 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Because the physical disk can only handle one operation at a
+//	time, requests that arrive while it is busy are queued, and the
+//	interrupt handler starts the next one when the current one is
+//	done.  The queue is shared with the interrupt handler, so it is
+//	protected by disabling interrupts rather than by a lock.  Each
+//	requesting thread waits on its own semaphore, which the
+//	interrupt handler signals when the thread's request completes.
+//
+//	The next request is chosen by one of several policies, set with
+//	the -ds flag (see Kernel::Kernel), so that they can be compared:
+//	FIFO, shortest seek first, or C-LOOK.
+//
+//	There may be several disks (the -raid flag), each with its own
+//	queue, working at the same time.  A sector the file system asks
+//	for is mapped to a disk, and a sector on it, by the array's
+//	layout; a run of sectors that crosses from one disk to another
+//	is split into one request per disk.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,20 +29,35 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "main.h"
 
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
-// 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+// 	Initialize the synchronous interface to the physical disks, in
+//	turn initializing the physical disks.
 //
+//	"policy" -- how to order requests waiting for each disk
+//	"mapDisk" -- map the disks' UNIX files into memory
+//	"model" -- how long a disk takes to serve a request
+//	"numDisks" -- how many disks there are (SetDiskArray must have
+//		been told the same)
+//	"layout" -- how they are combined
+//	"firstUnit" -- the unit number of the first disk (see Disk::Disk);
+//		other than 0 for a disk the file system does not use
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(DiskSchedule policy, bool mapDisk, DiskModel model,
+			int howMany, DiskArray arrayLayout, int firstUnit)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    numDisks = howMany;
+    layout = arrayLayout;
+    ASSERT(numDisks > 0);
+    ASSERT((layout == DiskMirrored) || (numDisks == 1)
+		|| (SectorsPerDisk % StripeSectors == 0));
+    disks = new DiskQueue *[numDisks];
+    for (int i = 0; i < numDisks; i++)
+	disks[i] = new DiskQueue(firstUnit + i, policy, mapDisk, model);
 }
 
 //----------------------------------------------------------------------
@@ -40,9 +68,31 @@ SynchDisk::SynchDisk()
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
-    delete lock;
-    delete semaphore;
+    for (int i = 0; i < numDisks; i++)
+	delete disks[i];
+    delete [] disks;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MirrorsAgree
+// 	Return FALSE if the disks are mirrored, and some of their UNIX
+//	files were just created (zero-filled) while the others already
+//	held data.  Reads are spread over all the mirrors, so the new
+//	ones would return zeroes for sectors the file system wrote; such
+//	an array can only be used once it is formatted again.
+//----------------------------------------------------------------------
+
+bool
+SynchDisk::MirrorsAgree()
+{
+    int numCreated = 0;
+
+    if (layout != DiskMirrored)
+	return TRUE;
+    for (int i = 0; i < numDisks; i++)
+	if (disks[i]->WasCreated())
+	    numCreated++;
+    return (numCreated == 0) || (numCreated == numDisks);
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +107,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(1, &sectorNumber, &data, FALSE);
 }
 
 //----------------------------------------------------------------------
@@ -75,20 +122,277 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(1, &sectorNumber, &data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write a list of disk sectors, returning only after all of
+//	them have been transferred.  The sectors need not be consecutive,
+//	but every run of consecutive sector numbers in the list is sent
+//	to the disk as one request, paying for one seek instead of one
+//	per sector.
+//
+//	"count" -- the number of sectors in the list
+//	"sectors" -- the disk sectors to read/write
+//	"data" -- data[i] is the buffer for sectors[i]
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int count, int *sectors, char** data)
+{
+    Transfer(count, sectors, data, FALSE);
+}
+
+void
+SynchDisk::WriteSectors(int count, int *sectors, char** data)
+{
+    Transfer(count, sectors, data, TRUE);
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::Sync
+// 	Make sure every disk's UNIX file is up to date.
 //----------------------------------------------------------------------
 
 void
-SynchDisk::CallBack()
+SynchDisk::Sync()
+{
+    for (int i = 0; i < numDisks; i++)
+	disks[i]->Sync();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MapSector
+// 	Return the sector of the array's disks that holds "sector", and
+//	set "unit" to the disk.  On a striped array, every StripeSectors
+//	sectors go to the next disk in turn; on a mirrored one, each disk
+//	has every sector where the file system thinks it is, and "unit"
+//	is set to -1.
+//
+//	"sector" -- the sector the file system asks for
+//	"unit" -- set to the disk that holds it
+//----------------------------------------------------------------------
+
+int
+SynchDisk::MapSector(int sector, int *unit)
+{
+    if (layout == DiskMirrored) {
+	*unit = -1;
+	return sector;
+    }
+    int stripe = sector / StripeSectors;
+    *unit = stripe % numDisks;
+    return (stripe / numDisks) * StripeSectors + sector % StripeSectors;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::LeastBusy
+// 	Return the disk of a mirrored array with the fewest requests
+//	queued or in progress, to read from.  Called with interrupts
+//	disabled.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::LeastBusy()
+{
+    int best = 0;
+
+    for (int i = 1; i < numDisks; i++)
+	if (disks[i]->Load() < disks[best]->Load())
+	    best = i;
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Split a list of sectors into runs of consecutive sectors on the
+//	same disk, queue one disk request per run, and wait for all of
+//	them.  The runs are queued together, so each disk's scheduler is
+//	free to reorder them among themselves and with other threads'
+//	requests, and the disks work on them at the same time.
+//
+//	On a mirrored array, each run is written to every disk, and read
+//	from whichever disk is least busy when the run is queued.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int count, int *sectors, char** data, bool writing)
+{
+    Semaphore *done = new Semaphore("synch disk request", 0);
+    int copies = (writing && (layout == DiskMirrored)) ? numDisks : 1;
+    DiskRequest *requests = new DiskRequest[count * copies];
+    int numRequests = 0;
+    int first, next, unit, nextUnit;
+
+    for (first = 0; first < count; first = next) {
+	int diskSector = MapSector(sectors[first], &unit);
+	next = first + 1;
+	while ((next < count)
+		&& (MapSector(sectors[next], &nextUnit) == diskSector + next - first)
+		&& (nextUnit == unit))
+	    next++;
+	for (int copy = 0; copy < copies; copy++) {
+	    DiskRequest *request = &requests[numRequests++];
+	    request->sector = diskSector;
+	    request->count = next - first;
+	    request->data = &data[first];
+	    request->writing = writing;
+	    request->unit = (copies > 1) ? copy : unit;
+	    request->done = done;
+	}
+    }
+
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    for (int i = 0; i < numRequests; i++) {
+	if (requests[i].unit < 0)
+	    requests[i].unit = LeastBusy();
+	disks[requests[i].unit]->Add(&requests[i]);
+    }
+    for (int i = 0; i < numDisks; i++)
+	disks[i]->StartNext();
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    for (int i = 0; i < numRequests; i++)
+	done->P();			// wait for each interrupt
+    delete [] requests;
+    delete done;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::DiskQueue
+// 	Initialize one of the disks, with no requests.
+//
+//	"unit" -- which disk it is
+//	"policy" -- how to order requests waiting for the disk
+//	"mapDisk" -- map the disk's UNIX file into memory
+//	"model" -- how long the disk takes to serve a request
+//----------------------------------------------------------------------
+
+DiskQueue::DiskQueue(int unit, DiskSchedule schedPolicy, bool mapDisk,
+			DiskModel model)
+{
+    policy = schedPolicy;
+    queue = new List<DiskRequest *>;
+    current = NULL;
+    disk = new Disk(this, unit, mapDisk, model);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::~DiskQueue
+// 	De-allocate the disk and its (empty) queue.
+//----------------------------------------------------------------------
+
+DiskQueue::~DiskQueue()
+{
+    ASSERT(queue->IsEmpty() && (current == NULL));
+    delete disk;
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Add
+// 	Queue a request for the disk.  The caller starts the disk with
+//	StartNext once it has queued all its requests, so that the
+//	scheduler can choose among them.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::Add(DiskRequest *request)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    queue->Append(request);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Load
+// 	Return how many requests the disk has queued or in progress.
+//----------------------------------------------------------------------
+
+int
+DiskQueue::Load()
+{
+    return queue->NumInList() + ((current != NULL) ? 1 : 0);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::StartNext
+// 	If the disk is idle, send it the next queued request.
+//
+//	Called with interrupts disabled, either by a thread queueing
+//	requests or by the interrupt handler.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::StartNext()
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    if ((current != NULL) || queue->IsEmpty())
+	return;
+
+    current = PickNext();
+    if (current->writing)
+	disk->WriteRequest(current->sector, current->count, current->data);
+    else
+	disk->ReadRequest(current->sector, current->count, current->data);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::PickNext
+// 	Remove and return the queued request to send next, relative to
+//	where the disk head is now:
+//
+//	  DiskFIFO  -- the oldest request
+//	  DiskSSTF  -- the request closest to the head, in either direction
+//	  DiskCLOOK -- the lowest request at or beyond the head; if there
+//		       is none, the lowest request of all (the head sweeps
+//		       up the disk, then returns to the start)
+//
+//	The queue is short, so we just scan it.
+//----------------------------------------------------------------------
+
+DiskRequest *
+DiskQueue::PickNext()
+{
+    int head = disk->HeadPosition();
+    DiskRequest *best = NULL;
+
+    if (policy == DiskFIFO)
+	return queue->RemoveFront();
+
+    ListIterator<DiskRequest *> iter(queue);
+    for (; !iter.IsDone(); iter.Next()) {
+	DiskRequest *request = iter.Item();
+	if (best == NULL) {
+	    best = request;
+	} else if (policy == DiskSSTF) {
+	    if (abs(request->sector - head) < abs(best->sector - head))
+		best = request;
+	} else {			// DiskCLOOK
+	    bool ahead = (request->sector >= head);
+	    bool bestAhead = (best->sector >= head);
+	    if ((ahead && !bestAhead)
+		    || ((ahead == bestAhead) && (request->sector < best->sector)))
+		best = request;
+	}
+    }
+    queue->Remove(best);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::CallBack
+// 	Disk interrupt handler.  Wake up the thread waiting for the
+//	request that just finished, and start the next one.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::CallBack()
 { 
-    semaphore->V();
+    DiskRequest *finished = current;
+
+    ASSERT(finished != NULL);
+    current = NULL;
+    finished->done->V();
+    StartNext();
 }
@@ -14,6 +14,79 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "list.h"
+
+// The order in which queued requests are sent to the disk.
+
+enum DiskSchedule {
+    DiskFIFO,		// in order of arrival
+    DiskSSTF,		// shortest seek first: closest to the head
+    DiskCLOOK		// elevator: sweep towards higher sectors, then
+			// jump back to the lowest pending one
+};
+
+// How the disks are combined into the one disk the file system sees.
+
+enum DiskArray {
+    DiskStriped,	// RAID-0: runs of StripeSectors sectors go to
+			// each disk in turn; NumSectors adds them up
+    DiskMirrored	// RAID-1: every disk holds every sector; writes go
+			// to all of them, reads to the least busy
+};
+
+#define StripeSectors	8	// Consecutive sectors kept together on one
+				// disk of a striped array
+
+// The following class defines one pending request to a disk: a run
+// of consecutive sectors to be read or written.
+
+class DiskRequest {
+  public:
+    int sector;				// First sector of the run, on the disk
+    int count;				// Number of sectors in the run
+    char **data;			// data[i] is the buffer for
+					//   sector + i
+    bool writing;			// Write, rather than read?
+    int unit;				// Which disk; -1 for a read of a
+					// mirrored array, sent to whichever
+					// disk is least busy
+    Semaphore *done;			// V'ed when the request completes
+};
+
+// The following class defines the requests of one disk: those
+// waiting, and the one the disk is working on.  Each disk interrupts
+// on its own, so each has its own queue.  All the methods but Sync
+// must be called with interrupts disabled.
+
+class DiskQueue : public CallBackObj {
+  public:
+    DiskQueue(int unit, DiskSchedule policy, bool mapDisk, DiskModel model);
+					// Initialize the raw Disk, and an
+					// empty queue
+    ~DiskQueue();
+
+    void Add(DiskRequest *request);	// Queue a request
+    void StartNext();			// Send the next request to the
+					// disk, if it is idle
+    int Load();				// # of requests queued or in
+					// progress
+    void Sync() { disk->Sync(); }
+    bool WasCreated() { return disk->WasCreated(); }
+
+    void CallBack();			// Called by the disk device interrupt
+					// handler, to signal that the
+					// current disk operation is complete.
+
+  private:
+    Disk *disk;		  		// Raw disk device
+    DiskSchedule policy;		// How to pick the next request
+    List<DiskRequest *> *queue;		// Requests waiting for the disk
+    DiskRequest *current;		// Request the disk is working on,
+					// NULL if the disk is idle
+
+    DiskRequest *PickNext();		// Take the next request off the
+					// queue, according to "policy"
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -25,11 +98,23 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Requests from different threads are kept in a queue while the disk
+// is busy, and the next one to send is chosen by the scheduling
+// policy.  Each thread waits on a semaphore of its own, which is
+// signalled when its requests are done.
+//
+// There may be several disks, combined as a DiskArray, each with its
+// own queue; the sectors the file system asks for are mapped to sectors
+// of the disks here.
 
-class SynchDisk : public CallBackObj {
+class SynchDisk {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(DiskSchedule policy = DiskCLOOK, bool mapDisk = FALSE,
+	DiskModel model = DiskRotational, int numDisks = 1,
+	DiskArray layout = DiskStriped, int firstUnit = 0);
+    					// Initialize a synchronous disk,
+					// by initializing the raw Disks.
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -39,17 +124,30 @@ class SynchDisk : public CallBackObj {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
-    
-    void CallBack();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+
+    void ReadSectors(int count, int *sectors, char** data);
+    void WriteSectors(int count, int *sectors, char** data);
+    					// Read/write a list of sectors;
+					// data[i] is the buffer for
+					// sectors[i].  Each run of
+					// consecutive sector numbers goes
+					// to the disk as a single request.
+
+    void Sync();			// Make sure the disks' UNIX files
+					// are up to date (see disk.h)
+    bool MirrorsAgree();		// FALSE if some mirrors were just
+					// created, empty, and some not
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    int numDisks;			// # of disks in the array
+    DiskArray layout;			// ... and how they are combined
+    DiskQueue **disks;			// The disks' queues
+
+    void Transfer(int count, int *sectors, char** data, bool writing);
+    int MapSector(int sector, int *unit);
+					// The disk and sector on it holding
+					// "sector"; unit -1 if mirrored
+    int LeastBusy();			// The mirror to read from
 };
 
 #endif // SYNCHDISK_H
@@ -30,9 +30,14 @@ Bitmap::Bitmap(int numItems)
     for (i = 0; i < numWords; i++) {
 	map[i] = 0;		// initialize map to keep Purify happy
     }
-    for (i = 0; i < numBits; i++) {
-        Clear(i);
+    if (numBits % BitsInWord == 0) {
+	lastWordMask = ~0u;
+    } else {
+	lastWordMask = (1u << (numBits % BitsInWord)) - 1;
     }
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
+    summary = new unsigned int[numSummaryWords];
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -43,6 +48,68 @@ Bitmap::Bitmap(int numItems)
 Bitmap::~Bitmap()
 { 
     delete map;
+    delete [] summary;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FreeBits
+// 	Return the clear bits of one word of the map, as 1's.  Bits
+//	past the end of the bitmap, in the last word, never count as clear.
+//
+//	"word" is the index of the word in the map.
+//----------------------------------------------------------------------
+
+unsigned int
+Bitmap::FreeBits(int word) const
+{
+    unsigned int free = ~map[word];
+
+    if (word == numWords - 1) {
+	free &= lastWordMask;
+    }
+    return free;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::UpdateSummary
+// 	Set or clear the summary bit for one word of the map, depending
+//	on whether the word has any clear bits left.
+//
+//	"word" is the index of the word in the map.
+//----------------------------------------------------------------------
+
+void
+Bitmap::UpdateSummary(int word)
+{
+    unsigned int bit = 1u << (word % BitsInWord);
+
+    if (FreeBits(word) == 0) {
+	summary[word / BitsInWord] |= bit;
+    } else {
+	summary[word / BitsInWord] &= ~bit;
+    }
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Recount
+// 	Recompute the count of clear bits and the summary from scratch.
+//	Needed whenever "map" is written without going through Mark
+//	and Clear, for instance when it is read in from disk.
+//----------------------------------------------------------------------
+
+void
+Bitmap::Recount()
+{
+    int i;
+
+    numClear = 0;
+    for (i = 0; i < numSummaryWords; i++) {
+	summary[i] = ~0u;	// padding past numWords stays "full"
+    }
+    for (i = 0; i < numWords; i++) {
+	numClear += __builtin_popcount(FreeBits(i));
+	UpdateSummary(i);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -57,7 +124,16 @@ Bitmap::Mark(int which)
 { 
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
+    if (!(map[word] & bit)) {
+	map[word] |= bit;
+	numClear--;
+	if (FreeBits(word) == 0) {
+	    UpdateSummary(word);
+	}
+    }
 
     ASSERT(Test(which));
 }
@@ -74,7 +150,14 @@ Bitmap::Clear(int which)
 {
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
+    if (map[word] & bit) {
+	map[word] &= ~bit;
+	numClear++;
+	summary[word / BitsInWord] &= ~(1u << (word % BitsInWord));
+    }
 
     ASSERT(!Test(which));
 }
@@ -104,38 +187,122 @@ Bitmap::Test(int which) const
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
+//	The summary tells us which word holds the first clear bit, and
+//	the word itself where in it the bit is.
+//
 //	If no bits are clear, return -1.
 //----------------------------------------------------------------------
 
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    if (numClear == 0) {
+	return -1;
+    }
+    for (int i = 0; i < numSummaryWords; i++) {
+	if (summary[i] != ~0u) {
+	    int word = i * BitsInWord + __builtin_ctz(~summary[i]);
+	    int which = word * BitsInWord + __builtin_ctz(FreeBits(word));
+	    Mark(which);
+	    return which;
 	}
     }
+    ASSERT(FALSE);		// numClear says there is a clear bit
     return -1;
 }
 
 //----------------------------------------------------------------------
-// Bitmap::NumClear
-// 	Return the number of clear bits in the bitmap.
-//	(In other words, how many bits are unallocated?)
+// Bitmap::ScanRuns
+// 	Look for runs of clear bits, a word at a time.  Words with no
+//	clear bits are skipped using the summary; within a word, the
+//	lengths of the runs of set and clear bits are found by counting
+//	trailing zeros.
+//
+//	Return the first bit of the first run of at least "wanted" clear
+//	bits, with "wanted" in "length".  If there is none, return the
+//	first bit of the longest run, and its length in "length"; -1 if
+//	there are no clear bits at all.
 //----------------------------------------------------------------------
 
-int 
-Bitmap::NumClear() const
+int
+Bitmap::ScanRuns(int wanted, int *length) const
 {
-    int count = 0;
+    int bestStart = -1, bestLength = 0;
+    int runStart = -1, runLength = 0;
 
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
+    for (int word = 0; word < numWords; word++) {
+	if (word % BitsInWord == 0 && summary[word / BitsInWord] == ~0u) {
+	    runLength = 0;		// 32 full words; skip them all
+	    word += BitsInWord - 1;
+	    continue;
+	}
+	unsigned int free = FreeBits(word);
+	int pos = 0;
+	while (pos < BitsInWord) {
+	    unsigned int rest = free >> pos;
+	    if (rest == 0) {		// the rest of the word is in use
+		runLength = 0;
+		break;
+	    }
+	    int used = __builtin_ctz(rest);
+	    if (used > 0) {
+		runLength = 0;
+		pos += used;
+		rest >>= used;
+	    }
+	    int clear = (~rest == 0) ? BitsInWord : __builtin_ctz(~rest);
+	    if (runLength == 0) {
+		runStart = word * BitsInWord + pos;
+	    }
+	    runLength += clear;
+	    pos += clear;
+	    if (runLength >= wanted) {
+		*length = wanted;
+		return runStart;
+	    }
+	    if (runLength > bestLength) {
+		bestStart = runStart;
+		bestLength = runLength;
+	    }
 	}
     }
-    return count;
+    *length = bestLength;
+    return bestStart;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindRun
+// 	Return the number of the first bit of the first run of "n"
+//	consecutive clear bits, or -1 if there is no such run.  The bits
+//	are not set; that is up to the caller.
+//
+//	"n" is the length of the run wanted.
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindRun(int n) const
+{
+    int length;
+
+    ASSERT(n > 0);
+    if (n > numClear) {
+	return -1;
+    }
+    int start = ScanRuns(n, &length);
+    return (length == n) ? start : -1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindLongestRun
+// 	Return the number of the first bit of the longest run of
+//	consecutive clear bits, and its length in "length".  If no bits
+//	are clear, return -1 (and 0 in "length").
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindLongestRun(int *length) const
+{
+    return ScanRuns(numBits + 1, length);
 }
 
 //----------------------------------------------------------------------
@@ -181,10 +348,19 @@ Bitmap::SelfTest()
     Clear(1);
     Clear(31);
 
+    Mark(2);
+    Mark(5);
+    ASSERT(FindRun(2) == 0);
+    ASSERT(FindRun(3) == 6);
+    ASSERT(NumClear() == numBits - 2);
+    Clear(2);
+    Clear(5);
+
     for (i = 0; i < numBits; i++) {
         Mark(i);
     }
     ASSERT(FindAndSet() == -1);		// bitmap should be full!
+    ASSERT(NumClear() == 0 && FindRun(1) == -1);
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
@@ -8,6 +8,12 @@
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
 //
+//	Searches work a word at a time rather than a bit at a time.  The
+//	bitmap also keeps a count of its clear bits, and a second, smaller
+//	"summary" bitmap with one bit per word of the map, set when that
+//	word has no clear bits left, so that full stretches of the map
+//	can be skipped 32 words at a time.
+//
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -42,7 +48,15 @@ class Bitmap {
     int FindAndSet();         // Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
-    int NumClear() const;	// Return the number of clear bits
+    int NumClear() const { return numClear; }
+				// Return the number of clear bits
+    int FindRun(int n) const;	// Return the # of the first bit of a run
+				// of "n" clear bits, or -1 if there is
+				// none.  The bits are not set.
+    int FindLongestRun(int *length) const;
+				// Return the # of the first bit of the
+				// longest run of clear bits, and its
+				// length in "length"; -1 if none is clear
 
     void Print() const;		// Print contents of bitmap
     void SelfTest();		// Test whether bitmap is working
@@ -54,6 +68,23 @@ class Bitmap {
 				//  multiple of the number of bits in
 				//  a word)
     unsigned int *map;		// bit storage
+
+    void Recount();		// Recompute "numClear" and the summary,
+				// after "map" was changed directly
+
+  private:
+    int numClear;		// number of clear bits in the bitmap
+    int numSummaryWords;	// number of words in "summary"
+    unsigned int *summary;	// bit i is set if map[i] has no clear bits
+				// (and for the padding past numWords)
+    unsigned int lastWordMask;	// the bits of map[numWords - 1] that
+				// are part of the bitmap
+
+    unsigned int FreeBits(int word) const;
+				// The clear bits of map[word], as 1's
+    void UpdateSummary(int word);// Recompute the summary bit for map[word]
+    int ScanRuns(int wanted, int *length) const;
+				// Common code for FindRun and FindLongestRun
 };
 
 #endif // BITMAP_H
@@ -51,9 +51,7 @@ extern "C" {
 #include <signal.h>
 #include <sys/types.h>
 
-#ifndef NO_MPROT 
-#include <sys/mman.h>
-#endif
+#include <sys/mman.h>		// also for MapFile, with NO_MPROT
 
 // UNIX routines called by procedures in this file 
 
@@ -420,6 +418,51 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "length" bytes of an open file into memory, shared,
+//	so that stores to the memory are stores to the file.  Abort if
+//	the file cannot be mapped.
+//
+//	"fd" -- the file, open for reading and writing
+//	"length" -- the number of bytes to map; the file must be as long
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int length)
+{
+    void *addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+
+    ASSERT(addr != MAP_FAILED);
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Wait until what has been stored into a mapped file is on the
+//	file.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int length)
+{
+    int retVal = msync(addr, length, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int length)
+{
+    int retVal = munmap(addr, length);
+    ASSERT(retVal == 0);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -53,6 +53,12 @@ extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
 
+// Map a file into memory, instead of reading and writing it.
+// For simulating the disk.
+extern char *MapFile(int fd, int length);
+extern void SyncMappedFile(char *addr, int length);
+extern void UnmapFile(char *addr, int length);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
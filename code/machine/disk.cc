@@ -25,7 +25,51 @@
 
 const int MagicNumber = 0x456789ab;
 const int MagicSize = sizeof(int);
-const int DiskSize = (MagicSize + (NumSectors * SectorSize));
+
+int SectorsPerTrack = DefaultSectorsPerTrack;
+int NumTracks = DefaultNumTracks;
+int SectorsPerDisk = DefaultSectorsPerTrack * DefaultNumTracks;
+int NumSectors = DefaultSectorsPerTrack * DefaultNumTracks;
+
+static int disksInSeries = 1;		// # of disks NumSectors spans
+
+//----------------------------------------------------------------------
+// SetDiskGeometry
+// 	Change the shape of the simulated disks.  Must be called before
+//	the disks (and anything sized by NumSectors) are created.
+//
+//	"sectorsPerTrack" -- number of sectors on each track
+//	"numTracks" -- number of tracks on each disk
+//----------------------------------------------------------------------
+
+void
+SetDiskGeometry(int sectorsPerTrack, int numTracks)
+{
+    ASSERT(sectorsPerTrack > 0 && numTracks > 0);
+    SectorsPerTrack = sectorsPerTrack;
+    NumTracks = numTracks;
+    SectorsPerDisk = sectorsPerTrack * numTracks;
+    NumSectors = SectorsPerDisk * disksInSeries;
+}
+
+//----------------------------------------------------------------------
+// SetDiskArray
+// 	Say how many disks there are, and so how many sectors the file
+//	system sees.  Like SetDiskGeometry, must be called before the
+//	disks are created.
+//
+//	"numDisks" -- number of simulated disks
+//	"striped" -- are the disks' sectors added up (striped), or is
+//		each disk a copy of the others (mirrored)?
+//----------------------------------------------------------------------
+
+void
+SetDiskArray(int numDisks, bool striped)
+{
+    ASSERT(numDisks > 0);
+    disksInSeries = striped ? numDisks : 1;
+    NumSectors = SectorsPerDisk * disksInSeries;
+}
 
 
 //----------------------------------------------------------------------
@@ -35,20 +79,30 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 // 	ok to treat it as Nachos disk storage.
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"unit" -- which of the disks this is; disk 0 is DISK_<host id>,
+//		the others DISK_<host id>.<unit>
+//	"mapFile" -- map the UNIX file into memory, rather than reading
+//		and writing it
+//	"timing" -- the latency model
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, int unit, bool mapFile, DiskModel timing)
 {
     int magicNum;
     int tmp = 0;
 
-    DEBUG(dbgDisk, "Initializing the disk.");
+    DEBUG(dbgDisk, "Initializing disk " << unit << ".");
     callWhenDone = toCall;
+    model = timing;
     lastSector = 0;
     bufferInit = 0;
     
-    sprintf(diskname,"DISK_%d",kernel->hostName);
+    if (unit == 0)
+	sprintf(diskname,"DISK_%d",kernel->hostName);
+    else
+	sprintf(diskname,"DISK_%d.%d",kernel->hostName,unit);
     fileno = OpenForReadWrite(diskname, FALSE);
+    created = (fileno < 0);
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
 	ASSERT(magicNum == MagicNumber);
@@ -58,9 +112,18 @@ Disk::Disk(CallBackObj *toCall)
 	WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
 
 	// need to write at end of file, so that reads will not return EOF
-        Lseek(fileno, DiskSize - sizeof(int), 0);	
+        Lseek(fileno, MagicSize + SectorsPerDisk * SectorSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    mapped = NULL;
+    mappedSize = MagicSize + SectorsPerDisk * SectorSize;
+    if (mapFile) {
+	Lseek(fileno, 0, 2);
+	ASSERT(Tell(fileno) >= mappedSize);	// else touching the end of
+						// the mapping would fault
+	mapped = MapFile(fileno, mappedSize);
+	DEBUG(dbgDisk, "Mapped " << diskname << " into memory.");
+    }
     active = FALSE;
 }
 
@@ -72,9 +135,27 @@ Disk::Disk(CallBackObj *toCall)
 
 Disk::~Disk()
 {
+    if (mapped != NULL) {
+	UnmapFile(mapped, mappedSize);
+    }
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Sync()
+// 	Make sure the UNIX file holds everything written to the disk so
+//	far.  Only needed when the file is mapped; otherwise each write
+//	went to the file directly.
+//----------------------------------------------------------------------
+
+void
+Disk::Sync()
+{
+    if (mapped != NULL) {
+	SyncMappedFile(mapped, mappedSize);
+    }
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -113,40 +194,86 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, 1, &data);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, 1, &data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of consecutive disk
+//	sectors.  The whole run is transferred as one request: the head
+//	seeks to the first sector, and the rest follow as the disk
+//	rotates, with a single interrupt when the last one is done.
+//
+//	"firstSector" -- the first disk sector to read/write
+//	"numSectors" -- how many sectors are in the run
+//	"data" -- data[i] is the buffer for sector firstSector + i
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int firstSector, int numSectors, char** data)
+{
+    int ticks = ComputeLatency(firstSector, numSectors, FALSE);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((numSectors > 0) && (firstSector >= 0)
+		&& (firstSector + numSectors <= SectorsPerDisk));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+    DEBUG(dbgDisk, "Reading " << numSectors << " sectors from sector " << firstSector);
+    if (mapped == NULL)
+	Lseek(fileno, SectorSize * firstSector + MagicSize, 0);
+    for (int i = 0; i < numSectors; i++) {
+	if (mapped != NULL)
+	    bcopy(&mapped[MagicSize + (firstSector + i) * SectorSize],
+			data[i], SectorSize);
+	else
+	    Read(fileno, data[i], SectorSize);
+	if (debug->IsEnabled('d'))
+	    PrintSector(FALSE, firstSector + i, data[i]);
+    }
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    CountRequest(firstSector, numSectors, ticks);
+    UpdateLast(firstSector);
+    UpdateLast(firstSector + numSectors - 1);
     kernel->stats->numDiskReads++;
+    kernel->stats->numSectorsRead += numSectors;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int firstSector, int numSectors, char** data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(firstSector, numSectors, TRUE);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((numSectors > 0) && (firstSector >= 0)
+		&& (firstSector + numSectors <= SectorsPerDisk));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
-    if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+    DEBUG(dbgDisk, "Writing " << numSectors << " sectors to sector " << firstSector);
+    if (mapped == NULL)
+	Lseek(fileno, SectorSize * firstSector + MagicSize, 0);
+    for (int i = 0; i < numSectors; i++) {
+	if (mapped != NULL)
+	    bcopy(data[i], &mapped[MagicSize + (firstSector + i) * SectorSize],
+			SectorSize);
+	else
+	    WriteFile(fileno, data[i], SectorSize);
+	if (debug->IsEnabled('d'))
+	    PrintSector(TRUE, firstSector + i, data[i]);
+    }
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    CountRequest(firstSector, numSectors, ticks);
+    UpdateLast(firstSector);
+    UpdateLast(firstSector + numSectors - 1);
     kernel->stats->numDiskWrites++;
+    kernel->stats->numSectorsWritten += numSectors;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
@@ -249,6 +376,94 @@ Disk::ComputeLatency(int newSector, bool writing)
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::ComputeLatency()
+// 	Return how long it will take to read/write a run of "numSectors"
+//	consecutive sectors starting at "firstSector", according to the
+//	disk's latency model.
+//----------------------------------------------------------------------
+
+int
+Disk::ComputeLatency(int firstSector, int numSectors, bool writing)
+{
+    switch (model) {
+      case DiskSSD:
+	return FlashLatency(numSectors, writing);
+      case DiskRAM:
+	return RAMDiskTime;
+      default:
+	return RotationalLatency(firstSector, numSectors, writing);
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::RotationalLatency()
+// 	Return how long it will take a rotating disk to read/write a run
+//	of "numSectors" consecutive sectors starting at "firstSector".
+//
+//	The first sector costs whatever a single-sector request would;
+//	each following sector then passes under the head one RotationTime
+//	later.  When the run spills over onto the next track, the head
+//	has to move one track, which costs a SeekTime.
+//----------------------------------------------------------------------
+
+int
+Disk::RotationalLatency(int firstSector, int numSectors, bool writing)
+{
+    int lastSector = firstSector + numSectors - 1;
+    int tracksCrossed = lastSector / SectorsPerTrack 
+				- firstSector / SectorsPerTrack;
+    int latency = ComputeLatency(firstSector, writing)
+		+ (numSectors - 1) * RotationTime + tracksCrossed * SeekTime;
+
+    DEBUG(dbgDisk, "Request latency for " << numSectors << " sectors = " << latency);
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// Disk::FlashLatency()
+// 	Return how long it will take an SSD to read/write a run of
+//	"numSectors" consecutive sectors.
+//
+//	Consecutive sectors are on different flash channels, which
+//	transfer at the same time; so a run costs the command overhead,
+//	plus one read or program time for every FlashChannels sectors
+//	(or part thereof).  Where the run is on the disk does not matter.
+//----------------------------------------------------------------------
+
+int
+Disk::FlashLatency(int numSectors, bool writing)
+{
+    int perSector = writing ? FlashProgramTime : FlashReadTime;
+    int latency = FlashCommandTime
+		+ divRoundUp(numSectors, FlashChannels) * perSector;
+
+    DEBUG(dbgDisk, "Flash latency for " << numSectors << " sectors = " << latency);
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// Disk::CountRequest()
+// 	Account for a request that will take "ticks": how long the disk
+//	is busy, and, for a rotating disk, how much of that time goes to
+//	moving the head and waiting for the sector, rather than to
+//	transferring data (one RotationTime per sector).
+//
+//	"firstSector", "numSectors" -- the run of sectors requested
+//	"ticks" -- the request's latency
+//----------------------------------------------------------------------
+
+void
+Disk::CountRequest(int firstSector, int numSectors, int ticks)
+{
+    kernel->stats->numDiskBusyTicks += ticks;
+    if (model == DiskRotational) {
+	kernel->stats->numDiskMechanicalTicks += ticks - numSectors * RotationTime;
+	kernel->stats->numSeekTracks += abs(firstSector / SectorsPerTrack
+					- lastSector / SectorsPerTrack);
+    }
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
@@ -46,18 +46,69 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The timing above is that of the default, rotational, model.  The
+// disk can instead be timed as an SSD -- a fixed cost per request,
+// plus a read or program time per sector, with consecutive sectors
+// spread over FlashChannels chips that work in parallel -- or as a RAM
+// disk, which takes (almost) no time at all.  There is no seek, no
+// rotation and no track buffer in either (cf. stats.h for the times).
+//
+// Optionally, the UNIX file can be mapped into memory, so that a
+// transfer is a copy rather than a seek and a read or write system
+// call per sector.  The simulated timing is the same either way; the
+// mapped file is only sure to be up to date on disk after Sync.
+
+//
+// The sector size is fixed when Nachos is compiled (-DSECTOR_SIZE=n, a
+// multiple of sizeof(int)), since on-disk data structures are laid out
+// to fit a sector.  The number of tracks and of sectors per track can
+// be set with "-geometry" when Nachos starts, before the disk is
+// created; a disk must always be used with the geometry it was
+// formatted with.
+//
+// There may be several disks, each with its own UNIX file, its own
+// requests and its own interrupts; SynchDisk makes them look like one
+// larger (striped) or more reliable (mirrored) disk.  NumSectors is the
+// size of that disk, as the file system sees it.
+
+#ifndef SECTOR_SIZE
+#define SECTOR_SIZE	128
+#endif
+
+const int SectorSize = SECTOR_SIZE;	// number of bytes per disk sector
+const int DefaultSectorsPerTrack = 32;
+const int DefaultNumTracks = 32;
 
-const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 32;		// number of tracks per disk
-const int NumSectors = (SectorsPerTrack * NumTracks);
-					// total # of sectors per disk
+extern int SectorsPerTrack;		// number of sectors per disk track 
+extern int NumTracks;			// number of tracks per disk
+extern int SectorsPerDisk;		// total # of sectors per disk
+					// (SectorsPerTrack * NumTracks)
+extern int NumSectors;			// total # of sectors the file
+					// system sees: SectorsPerDisk, times
+					// the # of disks if they are striped
+
+extern void SetDiskGeometry(int sectorsPerTrack, int numTracks);
+					// Change the above
+extern void SetDiskArray(int numDisks, bool striped);
+					// ... and the # of disks
+
+enum DiskModel {
+    DiskRotational,	// seek, rotational delay and transfer
+    DiskSSD,		// flash, with parallel channels
+    DiskRAM		// no delay
+};
 
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
+    Disk(CallBackObj *toCall, int unit = 0, bool mapFile = FALSE,
+	DiskModel timing = DiskRotational);
+					// Create simulated disk # "unit".  
 					// Invoke toCall->CallBack() 
 					// when each request completes.
+					// If "mapFile", map the UNIX file
+					// into memory.  Requests take the
+					// time "timing" says.
     ~Disk();				// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
@@ -67,19 +118,47 @@ class Disk : public CallBackObj {
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadRequest(int firstSector, int numSectors, char** data);
+    void WriteRequest(int firstSector, int numSectors, char** data);
+    					// Read/write "numSectors" consecutive
+					// sectors as a single request, with
+					// one interrupt at the end.  data[i]
+					// is the buffer for the i'th sector.
+
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
     int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
-					// newSector will take: 
+					// newSector will take on a
+					// rotating disk: 
 					// (seek + rotational delay + transfer)
+    int ComputeLatency(int firstSector, int numSectors, bool writing);
+					// Return how long a multi-sector
+					// request will take, in the disk's
+					// model
+
+    int HeadPosition() { return lastSector; }
+					// The sector the head is over (the
+					// last one transferred)
+
+    void Sync();			// Write the mapped UNIX file back,
+					// if it is mapped
+
+    bool WasCreated() { return created; }
+					// Was the UNIX file just created,
+					// zero-filled?
 
   private:
     int fileno;				// UNIX file number for simulated disk 
     char diskname[32];			// name of simulated disk's file
+    char *mapped;			// the file, if mapped into memory;
+					// otherwise NULL
+    int mappedSize;			// # of bytes mapped
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
+    DiskModel model;			// How long requests take
     bool active;     			// Is a disk operation in progress?
+    bool created;			// Did the UNIX file not exist?
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
@@ -87,6 +166,10 @@ class Disk : public CallBackObj {
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    int RotationalLatency(int firstSector, int numSectors, bool writing);
+    int FlashLatency(int numSectors, bool writing);
+    void CountRequest(int firstSector, int numSectors, int ticks);
+					// Update the statistics
 };
 
 #endif // DISK_H
@@ -23,6 +23,9 @@
 #include "copyright.h"
 #include "main.h"
 #include "interrupt.h"
+#include "buffercache.h"
+#include "inode.h"
+#include "synchdisk.h"
 
 
 // String definitions for debugging messages
@@ -235,6 +238,13 @@ void
 Interrupt::Halt()
 {
     cout << "Machine halting!\n\n";
+#ifndef FILESYS_STUB
+    kernel->inodeTable->Flush();	// changed file headers, then
+#endif
+    kernel->bufferCache->Flush();	// get dirty sectors onto the disk
+					// before reporting disk statistics
+    kernel->synchDisk->Sync();		// and, if it is mapped, the disk
+					// onto its UNIX file
     kernel->stats->Print();
     delete kernel;	// Never returns.
 }
@@ -50,9 +50,11 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"numTLBEntries" -- the size of the TLB, or 0 to translate through
+//		a linear page table
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, int numTLBEntries)
 {
     int i;
 
@@ -61,15 +63,23 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    tlbSize = numTLBEntries;
+    if (tlbSize > 0) {
+	tlb = new TranslationEntry[tlbSize];
+	tlbASID = new int[tlbSize];
+	tlbLastUsed = new int[tlbSize];
+	for (i = 0; i < tlbSize; i++) {
+	    tlb[i].valid = FALSE;
+	    tlbASID[i] = 0;
+	    tlbLastUsed[i] = 0;
+	}
+    } else {	// use linear page table
+	tlb = NULL;
+	tlbASID = NULL;
+	tlbLastUsed = NULL;
+    }
     pageTable = NULL;
-#endif
+    currentASID = 0;
 
     singleStep = debug;
     CheckEndian();
@@ -83,8 +93,11 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    if (tlb != NULL) {
         delete [] tlb;
+        delete [] tlbASID;
+        delete [] tlbLastUsed;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -39,6 +39,7 @@ const int NumPhysPages = 32;
 
 const int MemorySize = (NumPhysPages * PageSize);
 const int TLBSize = 4;			// if there is a TLB, make it small
+					// (the default size, see Machine)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -93,8 +94,10 @@ class Interrupt;
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, int numTLBEntries = 0);
+				// Initialize the simulation of the hardware
+				// for running user programs, with a TLB
+				// if "numTLBEntries" > 0
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -134,6 +137,16 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// # of entries in the TLB
+    int *tlbASID;			// the address space each TLB entry
+					// belongs to; an entry matches only
+					// if this is currentASID
+    int currentASID;			// the running address space's id,
+					// so that the TLB need not be
+					// flushed on a context switch
+    int *tlbLastUsed;			// when each TLB entry last matched,
+					// for the kernel's LRU replacement
+					// (real hardware would not keep this)
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
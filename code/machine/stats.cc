@@ -20,8 +20,22 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numSectorsRead = numSectorsWritten = 0;
+    numDiskBusyTicks = numDiskMechanicalTicks = 0;
+    numSeekTracks = 0;
+    numCacheHits = numCacheMisses = numCacheEvictions = 0;
+    numPrefetches = numPrefetchHits = numPrefetchWasted = 0;
+    numFlusherWrites = numDirtyStalls = 0;
+    numDentryHits = numDentryMisses = 0;
+    numInodeHits = numInodeMisses = 0;
+    numDelayedAllocations = numDelayedSectors = 0;
+    numJournalOps = numJournalCommits = numJournalSectors = 0;
+    numJournalReplays = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageFaults = numPageEvictions = 0;
+    numSwapIns = numSwapOuts = 0;
+    numTLBHits = numTLBMisses = 0;
+    numPacketsSent = numPacketsRecvd = 0;
 }
 
 //----------------------------------------------------------------------
@@ -37,9 +51,37 @@ Statistics::Print()
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    cout << "Disk sectors: read " << numSectorsRead;
+		cout << ", written " << numSectorsWritten;
+		cout << ", tracks seeked " << numSeekTracks << "\n";
+    cout << "Disk time: busy " << numDiskBusyTicks;
+		cout << ", seeking and rotating " << numDiskMechanicalTicks << "\n";
+    cout << "Buffer cache: hits " << numCacheHits;
+		cout << ", misses " << numCacheMisses;
+		cout << ", evictions " << numCacheEvictions << "\n";
+    cout << "Read-ahead: prefetched " << numPrefetches;
+		cout << ", hits " << numPrefetchHits;
+		cout << ", wasted " << numPrefetchWasted << "\n";
+    cout << "Write-behind: written " << numFlusherWrites;
+		cout << ", writer stalls " << numDirtyStalls << "\n";
+    cout << "Dentry cache: hits " << numDentryHits;
+		cout << ", misses " << numDentryMisses << "\n";
+    cout << "Inode cache: hits " << numInodeHits;
+		cout << ", misses " << numInodeMisses << "\n";
+    cout << "Delayed allocation: allocations " << numDelayedAllocations;
+		cout << ", sectors " << numDelayedSectors << "\n";
+    cout << "Journal: transactions " << numJournalOps;
+		cout << ", commits " << numJournalCommits;
+		cout << ", sectors logged " << numJournalSectors;
+		cout << ", replayed " << numJournalReplays << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
-    cout << "Paging: faults " << numPageFaults << "\n";
+    cout << "Paging: faults " << numPageFaults;
+		cout << ", evictions " << numPageEvictions << "\n";
+    cout << "Swap: pages read " << numSwapIns;
+		cout << ", written " << numSwapOuts << "\n";
+    cout << "TLB: hits " << numTLBHits;
+		cout << ", misses " << numTLBMisses << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
 }
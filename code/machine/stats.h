@@ -30,9 +30,42 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numSectorsRead;		// number of sectors transferred by
+    int numSectorsWritten;	//   those requests
+    int numDiskBusyTicks;	// time the disk spent on requests,
+    int numDiskMechanicalTicks;	// of which seeking and rotating (0
+				// for the SSD and RAM disk models)
+    int numSeekTracks;		// number of tracks the disk head moved
+				// across to reach requests
+    int numCacheHits;		// number of sector accesses found in
+				// the buffer cache
+    int numCacheMisses;		// number of sector accesses that had
+				// to allocate a cache buffer
+    int numCacheEvictions;	// number of cached sectors replaced
+    int numPrefetches;		// number of sectors read ahead
+    int numPrefetchHits;	// number of those later asked for
+    int numPrefetchWasted;	// number evicted before being asked for
+    int numFlusherWrites;	// number of dirty sectors written behind
+    int numDirtyStalls;		// number of times a writer had to wait
+				// for dirty sectors to be written
+    int numDentryHits;		// number of name lookups found in, or
+    int numDentryMisses;	// missing from, the dentry cache
+    int numInodeHits;		// number of opens that found, or
+    int numInodeMisses;		// had to read in, the file's inode
+    int numDelayedAllocations;	// number of times delayed bytes were
+    int numDelayedSectors;	// given sectors, and how many sectors
+    int numJournalOps;		// number of journaled transactions,
+    int numJournalCommits;	// of groups of them logged,
+    int numJournalSectors;	// and of sectors logged
+    int numJournalReplays;	// number of groups replayed at mount
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPageEvictions;	// number of those that evicted a page
+    int numSwapIns;		// number of pages read from, and
+    int numSwapOuts;		// written to, swap space
+    int numTLBHits;		// number of translations found in,
+    int numTLBMisses;		// or missing from, the TLB
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
@@ -53,6 +86,11 @@ const int UserTick = 	   1;	// advance for each user-level instruction
 const int SystemTick =	  10; 	// advance each time interrupts are enabled
 const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
+const int FlashCommandTime = 20;// time an SSD takes to start a request
+const int FlashReadTime = 50;	// time to read one sector from flash
+const int FlashProgramTime = 200;// time to program (write) one sector
+const int FlashChannels =  4;	// # of flash chips an SSD uses at once
+const int RAMDiskTime =	   1;	// time for any RAM disk request
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
 const int TimerTicks = 	 100;  	// (average) time between timer interrupts
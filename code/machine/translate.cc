@@ -216,17 +216,21 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))) {
+        for (entry = NULL, i = 0; i < tlbSize; i++)
+    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))
+			&& (tlbASID[i] == currentASID)) {
 		entry = &tlb[i];			// FOUND!
+		tlbLastUsed[i] = kernel->stats->totalTicks;
 		break;
 	    }
 	if (entry == NULL) {				// not found
     	    DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
+	    kernel->stats->numTLBMisses++;
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	kernel->stats->numTLBHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -11,6 +11,7 @@
 #include "copyright.h"
 #include "alarm.h"
 #include "main.h"
+#include "frametable.h"
 
 //----------------------------------------------------------------------
 // Alarm::Alarm
@@ -43,6 +44,7 @@ Alarm::Alarm(bool doRandom, int quantum)
 //
 //	For now, just provide time-slicing.  Only need to time slice 
 //      if we're currently running something (in other words, not idle).
+//	The page replacement policy also gets to age its use bits.
 //----------------------------------------------------------------------
 
 void 
@@ -52,6 +54,7 @@ Alarm::CallBack()
     MachineStatus status = interrupt->getStatus();
     
 	timeCount++;
+	kernel->frameTable->Age();
 
 	if (status != IdleMode && timeCount * TimerTicks % timeSlice == 0) {
 		interrupt->YieldOnReturn();
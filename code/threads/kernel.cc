@@ -16,6 +16,12 @@
 #include "string.h"
 #include "synchconsole.h"
 #include "synchdisk.h"
+#include "buffercache.h"
+#include "journal.h"
+#include "inode.h"
+#include "frametable.h"
+#include "swapspace.h"
+#include "tlbmanager.h"
 #include "post.h"
 
 
@@ -31,8 +37,24 @@ Kernel::Kernel(int argc, char **argv)
     debugUserProg = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    cacheSize = NumCacheBuffers;
+    dirtyLimit = 0;		// default is half the cache
+    diskSchedule = DiskCLOOK;
+    mapDiskFlag = FALSE;
+    diskModel = DiskRotational;
+    numDisks = 1;
+    diskArray = DiskStriped;
+    replacementPolicy = ReplaceClock;
+    rawSwapFlag = FALSE;
+#ifdef USE_TLB
+    tlbSize = TLBSize;
+#else
+    tlbSize = 0;
+#endif
+    tlbReplacement = TLBRandom;
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    extentFlag = FALSE;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
@@ -58,9 +80,91 @@ Kernel::Kernel(int argc, char **argv)
 	    ASSERT(i + 1 < argc);
 	    consoleOut = argv[i + 1];
 	    i++;
+	} else if (strcmp(argv[i], "-cache") == 0) {
+	    ASSERT(i + 1 < argc);
+	    cacheSize = atoi(argv[i + 1]);
+	    ASSERT(cacheSize >= 2 * JournalReserve);
+					// half the cache holds the journal
+	    i++;
+	} else if (strcmp(argv[i], "-ds") == 0) {
+	    ASSERT(i + 1 < argc);
+	    if (strcmp(argv[i + 1], "fifo") == 0) {
+		diskSchedule = DiskFIFO;
+	    } else if (strcmp(argv[i + 1], "sstf") == 0) {
+		diskSchedule = DiskSSTF;
+	    } else {
+		ASSERT(strcmp(argv[i + 1], "clook") == 0);
+		diskSchedule = DiskCLOOK;
+	    }
+	    i++;
+	} else if (strcmp(argv[i], "-dm") == 0) {
+	    ASSERT(i + 1 < argc);
+	    if (strcmp(argv[i + 1], "ssd") == 0) {
+		diskModel = DiskSSD;
+	    } else if (strcmp(argv[i + 1], "ram") == 0) {
+		diskModel = DiskRAM;
+	    } else {
+		ASSERT(strcmp(argv[i + 1], "rotational") == 0);
+		diskModel = DiskRotational;
+	    }
+	    i++;
+	} else if (strcmp(argv[i], "-raid") == 0) {
+	    ASSERT(i + 2 < argc);
+	    ASSERT((strcmp(argv[i + 1], "0") == 0)
+			|| (strcmp(argv[i + 1], "1") == 0));
+	    diskArray = (atoi(argv[i + 1]) == 0) ? DiskStriped : DiskMirrored;
+	    numDisks = atoi(argv[i + 2]);
+	    ASSERT(numDisks > 0);
+	    SetDiskArray(numDisks, diskArray == DiskStriped);
+	    i += 2;
+	} else if (strcmp(argv[i], "-pr") == 0) {
+	    ASSERT(i + 1 < argc);
+	    if (strcmp(argv[i + 1], "fifo") == 0) {
+		replacementPolicy = ReplaceFIFO;
+	    } else if (strcmp(argv[i + 1], "esc") == 0) {
+		replacementPolicy = ReplaceSecondChance;
+	    } else if (strcmp(argv[i + 1], "aging") == 0) {
+		replacementPolicy = ReplaceAging;
+	    } else {
+		ASSERT(strcmp(argv[i + 1], "clock") == 0);
+		replacementPolicy = ReplaceClock;
+	    }
+	    i++;
+	} else if (strcmp(argv[i], "-tlb") == 0) {
+	    ASSERT(i + 2 < argc);
+	    tlbSize = atoi(argv[i + 1]);
+	    ASSERT(tlbSize > 0);
+	    if (strcmp(argv[i + 2], "fifo") == 0) {
+		tlbReplacement = TLBFIFO;
+	    } else if (strcmp(argv[i + 2], "lru") == 0) {
+		tlbReplacement = TLBLRU;
+	    } else {
+		ASSERT(strcmp(argv[i + 2], "random") == 0);
+		tlbReplacement = TLBRandom;
+	    }
+	    i += 2;
+	} else if (strcmp(argv[i], "-rawswap") == 0) {
+	    rawSwapFlag = TRUE;
+	} else if (strcmp(argv[i], "-mmap") == 0) {
+	    mapDiskFlag = TRUE;
+	} else if (strcmp(argv[i], "-geometry") == 0) {
+	    ASSERT(i + 2 < argc);
+	    int sectorsPerTrack = atoi(argv[i + 1]);
+	    int numTracks = atoi(argv[i + 2]);
+	    ASSERT((sectorsPerTrack * numTracks) % BitsInWord == 0);
+					// the free map is a whole # of words
+	    SetDiskGeometry(sectorsPerTrack, numTracks);
+	    i += 2;
+	} else if (strcmp(argv[i], "-dirty") == 0) {
+	    ASSERT(i + 1 < argc);
+	    dirtyLimit = atoi(argv[i + 1]);
+	    ASSERT(dirtyLimit > 0);
+	    i++;
 #ifndef FILESYS_STUB
 	} else if (strcmp(argv[i], "-f") == 0) {
 	    formatFlag = TRUE;
+	} else if (strcmp(argv[i], "-extents") == 0) {
+	    extentFlag = TRUE;
 #endif
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
@@ -74,8 +178,16 @@ Kernel::Kernel(int argc, char **argv)
             cout << "Partial usage: nachos [-rs randomSeed]\n";
 	    cout << "Partial usage: nachos [-s]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+	    cout << "Partial usage: nachos [-cache numSectors] [-dirty numSectors]\n";
+	    cout << "Partial usage: nachos [-ds fifo|sstf|clook] [-mmap]\n";
+	    cout << "Partial usage: nachos [-dm rotational|ssd|ram]\n";
+	    cout << "Partial usage: nachos [-raid 0|1 numDisks]\n";
+	    cout << "Partial usage: nachos [-pr fifo|clock|esc|aging] [-rawswap]\n";
+	    cout << "Partial usage: nachos [-tlb numEntries random|fifo|lru]\n";
+	    cout << "Partial usage: nachos [-geometry sectorsPerTrack numTracks]\n";
 #ifndef FILESYS_STUB
 	    cout << "Partial usage: nachos [-nf]\n";
+	    cout << "Partial usage: nachos [-f [-extents]]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
 	}
@@ -103,36 +215,57 @@ Kernel::Initialize()
     interrupt = new Interrupt;		// start up interrupt handling
     scheduler = new Scheduler();	// initialize the ready queue
     alarm = new Alarm(randomSlice, quantum);	// start up time slicing
-    machine = new Machine(debugUserProg);
+    machine = new Machine(debugUserProg, tlbSize);
+    tlbManager = NULL;
+    if (tlbSize > 0) {
+	tlbManager = new TLBManager((TLBReplacement) tlbReplacement);
+    }
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    synchDisk = new SynchDisk((DiskSchedule) diskSchedule, mapDiskFlag,
+				(DiskModel) diskModel, numDisks,
+				(DiskArray) diskArray);    //
+#ifndef FILESYS_STUB
+    if (!formatFlag && !synchDisk->MirrorsAgree()) {
+	cerr << "A -raid 1 mirror is new and empty; format the disks (-f).\n";
+	Exit(1);
+    }
+#endif
+    if (dirtyLimit == 0)
+	dirtyLimit = (cacheSize + 1) / 2;
+    ASSERT(dirtyLimit <= cacheSize);
+    bufferCache = new BufferCache(cacheSize, dirtyLimit);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
-    if(fileSystem->Create("swapSpace")) {
-		swapSpace = fileSystem->Open("swapSpace");
+    swapSpace = NULL;
+    if(!rawSwapFlag) {
+		(void) fileSystem->Create("swapSpace");
+		swapSpace = new SwapSpace(fileSystem->Open("swapSpace"));
 	}
 #else
-    semaphoreRead = new  std::map<int, Semaphore*>;
-    semaphoreWrite = new  std::map<int, Semaphore*>;
-    readerCount  =new std::map<int,int>;
-    OpenFileCount = new std::map<int, int>;
-    fileSystem = new FileSystem(formatFlag);
+    inodeTable = new InodeTable();
+    fileSystem = new FileSystem(formatFlag, extentFlag);
     // swapSpace creted in the root dir, the sector number of root directory is 1
-    if(fileSystem->Create("swapSpace", 0, 1)) {
-		swapSpace = fileSystem->Open("swapSpace",1);
+    // (left there by the last run, unless the disk was just formatted)
+    swapSpace = NULL;
+    if(!rawSwapFlag) {
+		(void) fileSystem->Create("swapSpace", 0, 1);
+		swapSpace = new SwapSpace(fileSystem->Open("swapSpace",1));
 	}
     fileSystem->MakeDir("bin",0,1);
     fileSystem->MakeDir("usr",0,1);
    
 #endif // FILESYS_STUB
+    if (rawSwapFlag) {		// on the disk after the file system's
+	swapSpace = new SwapSpace(new SynchDisk((DiskSchedule) diskSchedule,
+				mapDiskFlag, (DiskModel) diskModel, 1,
+				DiskStriped, numDisks));
+    }
     postOfficeIn = new PostOfficeInput(10);
     postOfficeOut = new PostOfficeOutput(reliability);
 
     //page fault
-    swapSpace_counter=0;
-    FIFOEntryList = new List<TranslationEntry*>();
-    freeMap = new Bitmap(NumPhysPages);
+    frameTable = new FrameTable((ReplacementPolicy) replacementPolicy);
 
     interrupt->Enable();
 }
@@ -151,8 +284,12 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
+    delete bufferCache;		// already flushed by Interrupt::Halt
     delete synchDisk;
     delete fileSystem;
+#ifndef FILESYS_STUB
+    delete inodeTable;
+#endif
     delete postOfficeIn;
     delete postOfficeOut;
     
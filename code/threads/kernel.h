@@ -27,6 +27,11 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class BufferCache;
+class InodeTable;
+class FrameTable;
+class SwapSpace;
+class TLBManager;
 class Semaphore;
 
 class Kernel {
@@ -57,30 +62,26 @@ class Kernel {
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+    BufferCache *bufferCache;	// cache of disk sectors, used by the
+				// file system
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
 
-    //sync for reader and writers, mulitple thread can hold same openfile but read write sync
-    // the key is the sector num of the filehdr 
-    std::map<int, Semaphore*> *semaphoreRead;
-    std::map<int, Semaphore*> *semaphoreWrite;
-    std::map<int, int> *readerCount;
-
-    // a file can only be removed and its sectors be reallocated if no thread is currenty opening it
-    std::map<int, int> *OpenFileCount;
-    
 #ifndef FILESYS_STUB
+    InodeTable *inodeTable;	// in-core inodes of the open files,
+				// with their readers/writer locks
     FileTable * globalFileTable;
   #endif
 List<Thread *> *waitingChildrenList;
     //page fault
-    OpenFile* swapSpace;
-    int swapSpace_counter;
-    List<TranslationEntry*>* FIFOEntryList;
-    Bitmap* freeMap;
+    SwapSpace *swapSpace;	// where pages not in memory are kept
+    TLBManager *tlbManager;	// refills the TLB, or NULL if the
+				// machine uses page tables
+    FrameTable *frameTable;	// physical pages, and the page to
+				// evict when none is free
 
   private:
 	//int quantum = 1;
@@ -90,8 +91,26 @@ List<Thread *> *waitingChildrenList;
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    int cacheSize;		// # of sectors in the buffer cache
+    int dirtyLimit;		// # of those that may be dirty
+    int diskSchedule;		// order in which disk requests are served
+				// (a DiskSchedule, see synchdisk.h)
+    bool mapDiskFlag;		// map the disk's UNIX file into memory
+    int diskModel;		// how long disk requests take (a
+				// DiskModel, see disk.h)
+    int numDisks;		// # of simulated disks,
+    int diskArray;		// and how they are combined (a
+				// DiskArray, see synchdisk.h)
+    int replacementPolicy;	// which page to evict (a
+				// ReplacementPolicy, see frametable.h)
+    bool rawSwapFlag;		// swap to a disk of its own, rather
+				// than to a file
+    int tlbSize;		// # of TLB entries, 0 for page tables
+    int tlbReplacement;		// which TLB entry to replace (a
+				// TLBReplacement, see tlbmanager.h)
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
+    bool extentFlag;		// format it with the extent layout
 #endif
 };
 
@@ -4,10 +4,15 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
-//              -f -cp <unix file> <nachos file>
+//              -f [-extents] -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D
 //              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -z -K -C -N -cache <# sectors> -dirty <# sectors>
+//              -ds <fifo|sstf|clook> -mmap -dm <rotational|ssd|ram>
+//              -geometry <sectors per track> <# tracks>
+//              -raid <0|1> <# disks>
+//              -pr <fifo|clock|esc|aging> -rawswap
+//              -tlb <# entries> <random|fifo|lru>
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
@@ -21,14 +26,36 @@
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -pr picks which page a page fault evicts: the oldest, by CLOCK
+//	(the default), by enhanced second chance, or by aging
+//    -rawswap keeps swapped-out pages on a simulated disk of their own
+//	(the one after the -raid disks), rather than in the file swapSpace
+//    -tlb translates user addresses through a TLB of the given size,
+//	refilled by the kernel on a miss, rather than a page table; the
+//	entry to replace is picked at random, oldest first, or LRU
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
+//    -extents makes -f lay files out as extents (runs of sectors),
+//	rather than as a tree of direct and indirect blocks
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -cache sets the number of sectors held in the buffer cache
+//    -dirty sets how many of them may be dirty before writers must wait
+//    -ds picks the order in which queued disk requests are served
+//    -mmap maps the simulated disk's UNIX file into memory, rather than
+//	reading and writing it a sector at a time (same simulated timing)
+//    -dm picks how the simulated disk is timed: a rotating disk (the
+//	default), an SSD or a RAM disk
+//    -geometry sets the shape (and so the size) of the simulated disk;
+//	a disk must always be used with the geometry it was formatted with
+//    -raid uses several simulated disks (DISK_<id>, DISK_<id>.1, ...),
+//	striped (0), or mirrored (1); each disk has the -geometry shape.
+//	Adding a mirror to disks already in use needs -f, since the new
+//	one starts out empty
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
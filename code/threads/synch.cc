@@ -301,3 +301,108 @@ void Condition::Broadcast(Lock* conditionLock)
         Signal(conditionLock);
     }
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a readers/writer lock, so that it can be used for
+//	synchronization.  Initially, no one holds it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    readOK = new Condition(debugName);
+    writeOK = new Condition(debugName);
+    numReaders = 0;
+    writing = FALSE;
+    numWaitingWriters = 0;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	Deallocate a readers/writer lock.  No one may be holding it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    ASSERT(numReaders == 0 && !writing);
+    delete writeOK;
+    delete readOK;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+// 	Wait until no writer holds the lock, or is waiting for it, and
+//	then share it with the other readers.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writing || (numWaitingWriters > 0)) {
+	readOK->Wait(lock);
+    }
+    numReaders++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseRead
+// 	Give up our share of the lock; the last reader out lets a
+//	waiting writer in.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(numReaders > 0);
+    numReaders--;
+    if (numReaders == 0) {
+	writeOK->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+// 	Wait until no one else holds the lock, and then hold it alone.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    numWaitingWriters++;
+    while (writing || (numReaders > 0)) {
+	writeOK->Wait(lock);
+    }
+    numWaitingWriters--;
+    writing = TRUE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseWrite
+// 	Give up the lock: to the next waiting writer if there is one,
+//	otherwise to all the waiting readers.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(writing);
+    writing = FALSE;
+    if (numWaitingWriters > 0) {
+	writeOK->Signal(lock);
+    } else {
+	readOK->Broadcast(lock);
+    }
+    lock->Release();
+}
@@ -140,4 +140,37 @@ class Condition {
     char* name;
     List<Semaphore *> *waitQueue;	// list of waiting threads
 };
+
+// The following class defines a "readers/writer lock".  Any number of
+// threads may hold it for reading at once, but a thread holding it for
+// writing excludes everyone else:
+//
+//	AcquireRead/ReleaseRead -- share the lock with other readers
+//
+//	AcquireWrite/ReleaseWrite -- hold the lock alone
+//
+// Waiting writers are preferred over new readers, so that a steady
+// stream of readers cannot keep a writer out forever.  The lock is not
+// recursive: a thread holding it must not try to acquire it again.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();
+    void ReleaseRead();
+    void AcquireWrite();
+    void ReleaseWrite();
+
+  private:
+    char *name;				// debugging assist
+    Lock *lock;				// protects the fields below
+    Condition *readOK;			// signalled when readers may enter
+    Condition *writeOK;			// signalled when a writer may enter
+    int numReaders;			// # of threads holding it to read
+    bool writing;			// is a thread holding it to write?
+    int numWaitingWriters;		// # of writers waiting for it
+};
 #endif // SYNCH_H
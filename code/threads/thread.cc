@@ -54,6 +54,10 @@ Thread::Thread(char* threadName)
     PID = threadNum++; //start from 0
     //the curr directory point to /root
     wdSector = 1;
+    journalDepth = 0;
+    journalReserved = 0;
+    bounceData = NULL;
+    bounceSectors = NULL;
     waitingFor=-1;
     cout<<"Thread with PID "<< PID <<" is generated!"<<endl;
 }
@@ -77,6 +81,8 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    delete [] bounceData;
+    delete [] bounceSectors;
 }
 
 //----------------------------------------------------------------------
@@ -119,6 +119,12 @@ class Thread {
 
     int wdSector;
     std:: string currPath;
+    int journalDepth;		// # of nested journal transactions the
+				// thread is in (see filesys/journal.h)
+    int journalReserved;	// # of sectors the outermost reserved
+    char *bounceData;		// a sector, and room for sector numbers,
+    int *bounceSectors;		// for OpenFile transfers to use (see
+				// filesys/openfile.cc); NULL until then
 // preprocess file table 
     FileVector *fileVector;
 
@@ -20,6 +20,9 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "frametable.h"
+#include "swapspace.h"
+#include "tlbmanager.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -67,17 +70,36 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace()
 {
-
+    pageTable = NULL;
+    numPages = 0;
+    executable = NULL;
+    asid = 0;
+    if (kernel->tlbManager != NULL) {
+	asid = kernel->tlbManager->AllocateASID();
+    }
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space, giving back the physical pages and
+//	the swap slots it still holds.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+   kernel->frameTable->lock->Acquire();
+   if (kernel->tlbManager != NULL) {
+	kernel->tlbManager->FreeASID(asid);
+   }
+   for (unsigned int i = 0; (pageTable != NULL) && (i < numPages); i++) {
+	if (pageTable[i].valid) {
+	    kernel->frameTable->Free(pageTable[i].physicalPage);
+	}
+	kernel->swapSpace->FreeSlot(pageTable[i].virtualPage);
+   }
+   kernel->frameTable->lock->Release();
+   delete [] pageTable;
+   delete executable;
 }
 
 
@@ -85,6 +107,10 @@ AddrSpace::~AddrSpace()
 // AddrSpace::Load
 // 	Load a user program into memory from a file.
 //
+//	Nothing is read in yet, beyond the header: each page is brought
+//	in when it is first touched (see LoadPage).  The file is kept
+//	open until the address space goes away.
+//
 //	Assumes that the page table has been initialized, and that
 //	the object code file is in NOFF format.
 //
@@ -94,10 +120,9 @@ AddrSpace::~AddrSpace()
 bool 
 AddrSpace::Load(char *fileName) 
 {
-    OpenFile *executable = kernel->fileSystem->Open(fileName,1);
-    NoffHeader noffH;
     unsigned int size;
 
+    executable = kernel->fileSystem->Open(fileName,1);
     if (executable == NULL) {
 	cerr << "Unable to open file " << fileName << "\n";
 	return FALSE;
@@ -130,42 +155,78 @@ AddrSpace::Load(char *fileName)
 
     DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
 
-// then, copy in the code and data segments into memory
-// Note: this code assumes that virtual address = physical address
-    if (noffH.code.size > 0) {
-        pageTable = new TranslationEntry[numPages];
-        for (int i = 0; i < numPages; i++) {
-	        pageTable[i].virtualPage = kernel->swapSpace_counter++;	// for now, virt page # != phys page #
-	        pageTable[i].physicalPage = -1;
-	        pageTable[i].valid = FALSE;
-	        pageTable[i].use = FALSE;
-	        pageTable[i].dirty = FALSE;
-	        pageTable[i].readOnly = FALSE; 
-
-            //Create a temporary buffer to copy the code
-            char* buffer = new char[PageSize];
-            //Read the code into the buffer
-            executable->ReadAt(buffer, PageSize, noffH.code.inFileAddr + (i * PageSize));
-            //Write the buffer into swapSpace file
-            kernel->swapSpace->WriteAt(buffer, PageSize, pageTable[i].virtualPage * PageSize);
-            //if(pageTable[i].physicalPage != -1){ //Free physical page
-                //Read data from executable and copy it into main memory
-                //executable->ReadAt(
-                //&(kernel->machine->mainMemory[pageTable[i].physicalPage * PageSize]), 
-                //PageSize, noffH.code.inFileAddr + (i * PageSize));
-                //Update FIFOEntryList, append the used physical page at the end of list
-                //kernel->FIFOEntryList->Append(&pageTable[i]);
-            //}
-            //else{ //No free physical page
-                //pageTable[i].valid = FALSE;
-            //}
-        }
+// then, set up the page table.  Each page is given a swap slot, but is
+// written there only once it has been changed.  Pages holding only code
+// are read-only.
+    pageTable = new TranslationEntry[numPages];
+    for (int i = 0; i < numPages; i++) {
+	pageTable[i].virtualPage = kernel->swapSpace->AllocateSlot();	// virt page # is the swap slot
+	pageTable[i].physicalPage = -1;
+	pageTable[i].valid = FALSE;
+	pageTable[i].use = FALSE;
+	pageTable[i].dirty = FALSE;
+	pageTable[i].readOnly =
+	    (i * PageSize >= noffH.code.virtualAddr) &&
+	    ((i + 1) * PageSize <= noffH.code.virtualAddr + noffH.code.size);
     }
 
-    delete executable;			// close file
     return TRUE;			// success
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::LoadPage
+// 	Fill a physical page with the contents of virtual page "vpn",
+//	which has just been touched.  If the page has been written to
+//	swap space, read it from there.  Otherwise it has never changed:
+//	it holds whatever parts of the code and initialized data lie in
+//	it, read straight from the executable, and zeroes elsewhere
+//	(uninitialized data and the stack).
+//
+//	"vpn" -- the virtual page to bring in
+//	"frame" -- where it goes, in main memory
+//----------------------------------------------------------------------
+
+void
+AddrSpace::LoadPage(int vpn, char *frame)
+{
+    int slot = pageTable[vpn].virtualPage;
+
+    if (kernel->swapSpace->HasCopy(slot)) {
+	DEBUG(dbgAddr, "Reading page " << vpn << " from swap slot " << slot);
+	kernel->swapSpace->ReadSlot(slot, frame);
+	return;
+    }
+    DEBUG(dbgAddr, "Reading page " << vpn << " from the executable");
+    bzero(frame, PageSize);
+    ReadSegment(&noffH.code, vpn, frame);
+#ifdef RDATA
+    ReadSegment(&noffH.readonlyData, vpn, frame);
+#endif
+    ReadSegment(&noffH.initData, vpn, frame);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReadSegment
+// 	Read the part of a segment of the executable that lies in
+//	virtual page "vpn", if any, into the page's place in memory.
+//
+//	"segment" -- the segment, as described by the NOFF header
+//	"vpn" -- the virtual page being brought in
+//	"frame" -- where it goes, in main memory
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReadSegment(Segment *segment, int vpn, char *frame)
+{
+    int start = max(segment->virtualAddr, vpn * PageSize);
+    int end = min(segment->virtualAddr + segment->size, (vpn + 1) * PageSize);
+
+    if (start < end) {
+	executable->ReadAt(&frame[start - vpn * PageSize], end - start,
+			segment->inFileAddr + (start - segment->virtualAddr));
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::Execute
 // 	Run a user program using the current thread
@@ -244,13 +305,20 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table; or,
+//	with a TLB, which address space's entries to match.  The TLB
+//	is not flushed: the entries of other spaces are left for when
+//	they run again.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    if (kernel->tlbManager != NULL) {
+	kernel->machine->currentASID = asid;
+    } else {
+	kernel->machine->pageTable = pageTable;
+	kernel->machine->pageTableSize = numPages;
+    }
 }
 
 
@@ -16,6 +16,7 @@
 #include "copyright.h"
 #include "filesys.h"
 #include "list.h"
+#include "noff.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -42,6 +43,9 @@ class AddrSpace {
 
     //page swap
     TranslationEntry* getPageEntry(int PageNum) { return &pageTable[PageNum]; }
+    unsigned int getNumPages() { return numPages; }
+    void LoadPage(int vpn, char *frame);// Fill a physical page with the
+					// contents of virtual page "vpn"
     
 
   private:
@@ -49,6 +53,16 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    OpenFile *executable;		// The program, kept open so that
+					// pages are read in when first
+					// touched
+    NoffHeader noffH;			// Where its segments are
+    int asid;				// Tags its TLB entries, if there is
+					// a TLB
+
+    void ReadSegment(Segment *segment, int vpn, char *frame);
+					// Copy in the part of "segment"
+					// that lies in virtual page "vpn"
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
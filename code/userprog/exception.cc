@@ -25,6 +25,9 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+#include "frametable.h"
+#include "swapspace.h"
+#include "tlbmanager.h"
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -293,64 +296,97 @@ ExceptionHandler(ExceptionType which)
 		  ASSERTNOTREACHED();
 	  }break;
 
+	  case SC_Fsync:{
+		  DEBUG(dbgSys, "fsync " << kernel->machine->ReadRegister(4) << "\n");
+	      int result;
+	      result = SysFsync(/* OpenFileId id */(int)kernel->machine->ReadRegister(4));
+	      DEBUG(dbgSys, "fsync returning with " << result << "\n");
+	      /* Prepare Result */
+	      kernel->machine->WriteRegister(2, (int)result);
+	      /* Modify return point */
+	      {
+	          /* set previous programm counter (debugging only)*/
+	          kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            
+	          /* set programm counter to next instruction (all Instructions are 4 byte wide)*/
+	          kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+	  
+	          /* set next programm counter for brach execution */
+	          kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+	      }
+	      return;
+		  ASSERTNOTREACHED();
+	  }break;
+
       default:
 	      cerr << "Unexpected system call " << type << "\n";
 	      break;
       }
       break;
-	//page fault
+	//page fault, or TLB miss
 	case PageFaultException:{
-		cout<<"Page Fault Exception!"<<endl;
 		//Fetch the virtual address where has PageFaultException
 		int pageFaultA = (int)kernel->machine->ReadRegister(BadVAddrReg);
 		//Fetch the virtual page number of the thread's pageTable
 		int pageFaultPN = (int)pageFaultA / PageSize;
-		//Check the free physical page number in main memory	
-		int PPN = kernel->freeMap->FindAndSet();
+		AddrSpace* space = kernel->currentThread->space;
+		//Without a TLB, the machine has checked this against the page table
+		if((unsigned int)pageFaultPN >= space->getNumPages()){
+			cerr << "Address out of range " << pageFaultA << "\n";
+			break;
+		}
 		//Fetch the page fault entry of the currentThread
-		TranslationEntry* pageEntry = kernel->currentThread->space->getPageEntry(pageFaultPN);
-		if(PPN != -1){ //Free physical page
-			//Update the page entry
-			pageEntry->physicalPage = PPN;
-		    pageEntry->valid = TRUE;
-		
-		    //Read data from swapSpace file and copy it into main memory
-		    kernel->swapSpace->ReadAt(
-			&(kernel->machine->mainMemory[PPN * PageSize]), 
-			PageSize, pageEntry->virtualPage * PageSize);
-		
-		    //Update FIFOEntryList, append the used physical page at the end of list
-		    kernel->FIFOEntryList->Append(pageEntry);
-	    }
-		else{ //No free physical page
-			//Fetch the evicted physical page from FIFOEntryList
-			TranslationEntry* evictedPage = kernel->FIFOEntryList->RemoveFront();
-			//Fetch the physical page number of the evictedPage
-			int PhysicalPN = evictedPage->physicalPage;
+		TranslationEntry* pageEntry = space->getPageEntry(pageFaultPN);
+		FrameTable* frameTable = kernel->frameTable;
 
-            //Copy evicted physical page data from main memory into swapSpace file
-			kernel->swapSpace->WriteAt(
-			&(kernel->machine->mainMemory[PhysicalPN * PageSize]),
-			PageSize, evictedPage->virtualPage * PageSize);
-          
-		    //Update the evictedPage entry
-			evictedPage->physicalPage = -1;
-			evictedPage->valid = FALSE;
+		//One page fault at a time: the swap I/O below may switch threads
+		frameTable->lock->Acquire();
+		if(!pageEntry->valid){ //Not in memory, not just missing from the TLB
+			cout<<"Page Fault Exception!"<<endl;
+			kernel->stats->numPageFaults++;
+			//Check the free physical page number in main memory
+			int PPN = frameTable->FindFree();
+			if(PPN == -1){ //No free physical page
+				//Ask the replacement policy for the page to evict
+				PPN = frameTable->FindVictim();
+				TranslationEntry* evictedPage = frameTable->Owner(PPN);
 
-			//Update the page entry
-			pageEntry->physicalPage = PhysicalPN;
-		    pageEntry->valid = TRUE;
+				//Update the evictedPage entry; its TLB entry, if any, has
+				//the latest dirty bit
+				if(kernel->tlbManager != NULL){
+					kernel->tlbManager->Invalidate(evictedPage);
+				}
+				evictedPage->physicalPage = -1;
+				evictedPage->valid = FALSE;
+
+				//Copy evicted physical page data from main memory into swap
+				//space if it has changed; a clean page can be read again from
+				//swap space or the executable
+				if(!evictedPage->readOnly && evictedPage->dirty){
+					kernel->swapSpace->WriteSlot(evictedPage->virtualPage,
+					&(kernel->machine->mainMemory[PPN * PageSize]));
+				}
+				kernel->stats->numPageEvictions++;
+				cout << "No free physical page available! Swap VPN #" << pageEntry->virtualPage << " of thread with PID " 
+				<< kernel->currentThread->PID << " for PPN #" << PPN << endl;
+			}
+			frameTable->Assign(PPN, pageEntry);
 
-            //Read data from swapSpace file and copy it into main memory
-			kernel->swapSpace->ReadAt(
-			&(kernel->machine->mainMemory[PhysicalPN * PageSize]),
-			PageSize, pageEntry->virtualPage * PageSize);
+			//Read data from swap space or the executable into main memory
+			space->LoadPage(pageFaultPN,
+			&(kernel->machine->mainMemory[PPN * PageSize]));
 
-			//Update FIFOEntryList, append the used physical page at the end of list
-            kernel->FIFOEntryList->Append(pageEntry);
-			cout << "No free physical page available! Swap VPN #" << pageEntry->virtualPage << " of thread with PID " 
-			<< kernel->currentThread->PID << " for PPN #" << PhysicalPN << endl;
+			//Update the page entry
+			pageEntry->physicalPage = PPN;
+			pageEntry->use = FALSE;
+			pageEntry->dirty = FALSE;
+			pageEntry->valid = TRUE;
+		}
+		//With a TLB, load the translation the machine missed
+		if(kernel->tlbManager != NULL){
+			kernel->tlbManager->Refill(pageFaultPN, pageEntry);
 		}
+		frameTable->lock->Release();
 		return;
 	}break;
 
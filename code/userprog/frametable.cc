@@ -0,0 +1,211 @@
+// frametable.cc
+//	Routines to manage the frames of physical memory, and to choose
+//	which page to evict when they are all in use.
+//
+//	The table does not move pages itself: the page fault handler
+//	writes the victim out, reads the faulting page in, and tells the
+//	table about it, all with the table's lock held.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "frametable.h"
+#include "machine.h"
+#include "tlbmanager.h"
+
+//----------------------------------------------------------------------
+// FrameTable::FrameTable
+// 	Initialize the table of physical frames, all of them free.
+//
+//	"policy" -- how to choose the page to evict
+//----------------------------------------------------------------------
+
+FrameTable::FrameTable(ReplacementPolicy policy)
+{
+    this->policy = policy;
+    freeFrames = new Bitmap(NumPhysPages);
+    owner = new TranslationEntry *[NumPhysPages];
+    loadTime = new int[NumPhysPages];
+    age = new unsigned char[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++) {
+	owner[i] = NULL;
+	loadTime[i] = 0;
+	age[i] = 0;
+    }
+    numLoads = 0;
+    clockHand = 0;
+    lock = new Lock("frame table lock");
+}
+
+//----------------------------------------------------------------------
+// FrameTable::~FrameTable
+// 	De-allocate the table.
+//----------------------------------------------------------------------
+
+FrameTable::~FrameTable()
+{
+    delete lock;
+    delete [] age;
+    delete [] loadTime;
+    delete [] owner;
+    delete freeFrames;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::FindFree
+// 	Return a frame holding no page, marking it as in use, or -1 if
+//	every frame holds one.
+//----------------------------------------------------------------------
+
+int
+FrameTable::FindFree()
+{
+    return freeFrames->FindAndSet();
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Assign
+// 	Record that "frame" now holds the page of "entry".  The frame was
+//	returned by FindFree or FindVictim.
+//
+//	"frame" -- the physical page number
+//	"entry" -- the page table entry of the page brought in
+//----------------------------------------------------------------------
+
+void
+FrameTable::Assign(int frame, TranslationEntry *entry)
+{
+    ASSERT(freeFrames->Test(frame));
+    owner[frame] = entry;
+    loadTime[frame] = numLoads++;
+    age[frame] = 0x80;			// as if used in the last tick
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Free
+// 	The page held in "frame" has gone with its address space; the
+//	frame is free again.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+FrameTable::Free(int frame)
+{
+    owner[frame] = NULL;
+    freeFrames->Clear(frame);
+}
+
+//----------------------------------------------------------------------
+// FrameTable::FindVictim
+// 	Choose a frame whose page is to be evicted, according to the
+//	replacement policy.  Called only when no frame is free, so that
+//	every frame holds a page.
+//
+//	CLOCK takes the first page whose use bit is clear, clearing use
+//	bits as the hand passes over them.  Enhanced second chance sweeps
+//	looking first for a page that is neither used nor dirty, without
+//	changing anything; then for one that is not used but dirty,
+//	clearing use bits; and so on -- by the fourth sweep it has found
+//	one.
+//----------------------------------------------------------------------
+
+int
+FrameTable::FindVictim()
+{
+    ASSERT(freeFrames->NumClear() == 0);
+    if (kernel->tlbManager != NULL) {
+	kernel->tlbManager->SyncBits();	// the TLB has the latest bits
+    }
+
+    switch (policy) {
+      case ReplaceFIFO:
+	return OldestFrame(FALSE);
+
+      case ReplaceAging:
+	return OldestFrame(TRUE);
+
+      case ReplaceClock:
+	for (int i = 0; i < 2 * NumPhysPages; i++) {	// two sweeps are enough
+	    int frame = clockHand;			// to clear every bit
+	    clockHand = (clockHand + 1) % NumPhysPages;
+
+	    if (!owner[frame]->use) {
+		return frame;
+	    }
+	    owner[frame]->use = FALSE;		// second chance
+	}
+	break;
+
+      case ReplaceSecondChance:
+	for (int i = 0; i < 4 * NumPhysPages; i++) {
+	    int frame = clockHand;
+	    bool wantDirty = ((i / NumPhysPages) % 2 == 1);
+	    clockHand = (clockHand + 1) % NumPhysPages;
+
+	    if (!owner[frame]->use && (owner[frame]->dirty == wantDirty)) {
+		return frame;
+	    }
+	    if (wantDirty) {
+		owner[frame]->use = FALSE;	// second chance
+	    }
+	}
+	break;
+    }
+    ASSERTNOTREACHED();
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::OldestFrame
+// 	Return the frame whose page was brought in first or, if "byAge",
+//	the one whose aging counter is smallest (the earlier brought in,
+//	among equals).
+//
+//	"byAge" -- compare the aging counters first?
+//----------------------------------------------------------------------
+
+int
+FrameTable::OldestFrame(bool byAge)
+{
+    int oldest = 0;
+
+    for (int i = 1; i < NumPhysPages; i++) {
+	if (byAge && (age[i] != age[oldest])) {
+	    if (age[i] < age[oldest]) {
+		oldest = i;
+	    }
+	} else if (loadTime[i] < loadTime[oldest]) {
+	    oldest = i;
+	}
+    }
+    return oldest;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Age
+// 	Shift each page's use bit into the top of its frame's aging
+//	counter, and clear it.  Called at every timer interrupt, with
+//	interrupts disabled; does nothing unless the policy is aging,
+//	so as not to clear the use bits the other policies go by.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Age()
+{
+    if (policy != ReplaceAging) {
+	return;
+    }
+    if (kernel->tlbManager != NULL) {
+	kernel->tlbManager->SyncBits();
+    }
+    for (int i = 0; i < NumPhysPages; i++) {
+	if (owner[i] != NULL) {
+	    age[i] = (age[i] >> 1) | (owner[i]->use ? 0x80 : 0);
+	    owner[i]->use = FALSE;
+	}
+    }
+}
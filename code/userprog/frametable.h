@@ -0,0 +1,83 @@
+// frametable.h
+//	Data structures to keep track of the frames of physical memory,
+//	and to choose the page to evict when a page fault finds no frame
+//	free.
+//
+//	Every frame in use records the page table entry of the virtual
+//	page it holds, so that the entry can be invalidated when the page
+//	is evicted, and so that its use and dirty bits (set by
+//	Machine::Translate) can guide the choice of victim:
+//
+//	   FIFO -- the page that has been in memory longest
+//	   CLOCK -- a hand sweeps over the frames, clearing use bits; the
+//		first page whose bit is already clear is chosen
+//	   enhanced second chance -- as CLOCK, but a page that is neither
+//		used nor dirty is preferred to one that is only dirty, so
+//		that most evictions do not cost a write to swap
+//	   aging -- each frame has a counter; at every timer interrupt the
+//		counters are shifted right, with the page's use bit shifted
+//		in at the top, and the use bits are cleared.  The page with
+//		the smallest counter approximates the least recently used.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMETABLE_H
+#define FRAMETABLE_H
+
+#include "copyright.h"
+#include "translate.h"
+#include "bitmap.h"
+#include "synch.h"
+
+// The page replacement policies
+
+enum ReplacementPolicy {
+    ReplaceFIFO,			// Oldest page first
+    ReplaceClock,			// CLOCK, on the use bit
+    ReplaceSecondChance,		// Enhanced second chance, on the use
+					// and dirty bits
+    ReplaceAging			// Least recently used, approximated
+					// by aging counters
+};
+
+// The following class defines the table of physical frames (the
+// "core map").
+
+class FrameTable {
+  public:
+    FrameTable(ReplacementPolicy policy);
+					// Initialize a table with every frame
+					// free
+    ~FrameTable();
+
+    int FindFree();			// Take a free frame, or return -1
+    int FindVictim();			// Choose the frame whose page is to
+					// be evicted
+    void Assign(int frame, TranslationEntry *entry);
+					// "frame" now holds the page of
+					// "entry"
+    TranslationEntry *Owner(int frame) { return owner[frame]; }
+					// The entry of the page in "frame"
+    void Free(int frame);		// The page in "frame" is gone
+    void Age();				// Called at every timer interrupt
+
+    Lock *lock;				// Held while a page fault is handled,
+					// so that faults are serialized
+
+  private:
+    ReplacementPolicy policy;
+    Bitmap *freeFrames;			// Frames holding no page
+    TranslationEntry **owner;		// For each frame, the entry of the
+					// page it holds, or NULL
+    int *loadTime;			// For FIFO: when the page was
+					// brought in, counting page faults
+    unsigned char *age;			// For aging: the frame's counter
+    int numLoads;			// Pages brought in so far
+    int clockHand;			// Where the CLOCK sweep resumes
+
+    int OldestFrame(bool byAge);	// The frame with the oldest page
+};
+
+#endif // FRAMETABLE_H
@@ -16,6 +16,7 @@
 #include "list.h"
 #include "synchconsole.h"
 #include "debug.h"
+#include "buffercache.h"
 #define MAX_STRING_LENGTH 128  //max length 
 char *
 LoadStringFromMemory(int addr) {
@@ -163,6 +164,16 @@ int SysClose(OpenFileId id){                  // grab fileid to close
     return 0;
 }
 
+int SysFsync(OpenFileId id){
+  OpenFile *file = kernel->currentThread->fileVector->Resolve(id);
+  if (file == NULL)
+    return -1;
+  file->Sync();                     // delayed bytes, and the header
+  // flushes the whole cache, including this file's sectors
+  kernel->bufferCache->Flush();
+  return 0;
+}
+
 int SC_JOIN(SpaceId id){
    Thread *child = NULL;
   ListIterator<Thread *> *iter = new ListIterator<Thread *>(kernel->currentThread->childList);
@@ -0,0 +1,221 @@
+// swapspace.cc
+//	Routines to allocate swap slots, and to read and write the pages
+//	of user programs to and from them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "swapspace.h"
+#include "synchdisk.h"
+#include "machine.h"
+#ifndef FILESYS_STUB
+#include "pbitmap.h"
+#endif
+
+//----------------------------------------------------------------------
+// SwapSpace::SwapSpace
+// 	Initialize swap space in a Nachos file, with every slot free.
+//	A file left over from an earlier run keeps its size.  A new,
+//	empty one is written out once, here, to a slot for each page
+//	that half the free disk space can hold (up to SwapSlots), and
+//	synced, so that every sector is allocated: from then on, pages
+//	are written with WriteAt, which neither allocates nor journals.
+//
+//	"file" -- the open Nachos file holding the slots
+//----------------------------------------------------------------------
+
+SwapSpace::SwapSpace(OpenFile *file)
+{
+    ASSERT(file != NULL);
+    this->file = file;
+    device = NULL;
+    sectorsPerSlot = 0;
+    slotBuffer = NULL;
+#ifdef FILESYS_STUB
+    Initialize(SwapSlots);
+#else
+    int howMany = file->Length() / PageSize;
+
+    if (howMany == 0) {
+	char *zeros = new char[PageSize];
+
+	howMany = min(SwapSlots,
+		kernel->fileSystem->GetFreeMap()->NumClear() * SectorSize
+			/ PageSize / 2);
+	bzero(zeros, PageSize);
+	for (int i = 0; i < howMany; i++) {
+	    int numWritten = file->Write(zeros, PageSize);
+	    ASSERT(numWritten == PageSize);
+	}
+	file->Sync();
+	delete [] zeros;
+    }
+    ASSERT(howMany > 0);		// no room on the disk
+    Initialize(howMany);
+#endif
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::SwapSpace
+// 	Initialize swap space on a disk of its own, with every slot free.
+//	Each slot takes whole sectors, so that no two slots share one.
+//
+//	"device" -- the disk holding the slots
+//----------------------------------------------------------------------
+
+SwapSpace::SwapSpace(SynchDisk *device)
+{
+    file = NULL;
+    this->device = device;
+    sectorsPerSlot = divRoundUp(PageSize, SectorSize);
+    slotBuffer = new char[sectorsPerSlot * SectorSize];
+    bzero(slotBuffer, sectorsPerSlot * SectorSize);
+    Initialize(min(SwapSlots, SectorsPerDisk / sectorsPerSlot));
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Initialize
+// 	Set up the maps of slots, all of them free and without a copy of
+//	any page.
+//
+//	"howMany" -- the number of slots
+//----------------------------------------------------------------------
+
+void
+SwapSpace::Initialize(int howMany)
+{
+    numSlots = howMany;
+    used = new Bitmap(numSlots);
+    valid = new Bitmap(numSlots);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::~SwapSpace
+// 	De-allocate swap space, and close its file or disk.
+//----------------------------------------------------------------------
+
+SwapSpace::~SwapSpace()
+{
+    delete valid;
+    delete used;
+    if (slotBuffer != NULL) {
+	delete [] slotBuffer;
+    }
+    delete file;
+    delete device;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::AllocateSlot
+// 	Return the number of a free slot for a new virtual page.  The slot
+//	does not hold a copy of the page until WriteSlot is called.
+//----------------------------------------------------------------------
+
+int
+SwapSpace::AllocateSlot()
+{
+    int slot = used->FindAndSet();
+
+    ASSERT(slot != -1);			// out of swap space
+    valid->Clear(slot);
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::FreeSlot
+// 	The page given "slot" has gone with its address space; the slot
+//	may be given to another page.
+//
+//	"slot" -- the page's slot
+//----------------------------------------------------------------------
+
+void
+SwapSpace::FreeSlot(int slot)
+{
+    ASSERT(used->Test(slot));
+    used->Clear(slot);
+    valid->Clear(slot);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::WriteSlot
+// 	Write a page to its slot; the slot now holds a copy of it.  The
+//	page is being evicted dirty, so it cannot just be dropped if the
+//	write falls short.
+//
+//	The slot is inside the swap file, whose sectors were allocated
+//	when it was created, so writing it starts no journal transaction
+//	(which could wait, with the frame table locked).
+//
+//	"slot" -- the page's slot
+//	"page" -- the contents of the page, PageSize bytes
+//----------------------------------------------------------------------
+
+void
+SwapSpace::WriteSlot(int slot, char *page)
+{
+    ASSERT(used->Test(slot));
+    if (device == NULL) {
+	int numWritten = file->WriteAt(page, PageSize, slot * PageSize);
+	ASSERT(numWritten == PageSize);
+    } else {
+	bcopy(page, slotBuffer, PageSize);
+	TransferSlot(slot, TRUE);
+    }
+    valid->Mark(slot);
+    kernel->stats->numSwapOuts++;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::ReadSlot
+// 	Read a page from its slot, which must hold a copy of it.
+//
+//	"slot" -- the page's slot
+//	"page" -- where to put the contents of the page, PageSize bytes
+//----------------------------------------------------------------------
+
+void
+SwapSpace::ReadSlot(int slot, char *page)
+{
+    ASSERT(HasCopy(slot));
+    if (device == NULL) {
+	int numRead = file->ReadAt(page, PageSize, slot * PageSize);
+	ASSERT(numRead == PageSize);
+    } else {
+	TransferSlot(slot, FALSE);
+	bcopy(slotBuffer, page, PageSize);
+    }
+    kernel->stats->numSwapIns++;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::TransferSlot
+// 	Read or write the sectors of a slot on the swap disk, from or to
+//	"slotBuffer", with a single disk request.  Page faults are
+//	serialized (see FrameTable), so one buffer is enough.
+//
+//	"slot" -- the slot to transfer
+//	"writing" -- write the slot, rather than read it?
+//----------------------------------------------------------------------
+
+void
+SwapSpace::TransferSlot(int slot, bool writing)
+{
+    int *sectors = new int[sectorsPerSlot];
+    char **buffers = new char *[sectorsPerSlot];
+
+    for (int i = 0; i < sectorsPerSlot; i++) {
+	sectors[i] = slot * sectorsPerSlot + i;
+	buffers[i] = &slotBuffer[i * SectorSize];
+    }
+    if (writing) {
+	device->WriteSectors(sectorsPerSlot, sectors, buffers);
+    } else {
+	device->ReadSectors(sectorsPerSlot, sectors, buffers);
+    }
+    delete [] buffers;
+    delete [] sectors;
+}
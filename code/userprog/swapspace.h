@@ -0,0 +1,67 @@
+// swapspace.h
+//	Data structures to keep the pages of user programs that are not
+//	in physical memory.
+//
+//	Swap space is divided into slots, one page each.  Every virtual
+//	page is given a slot when its address space is loaded, and its
+//	page table entry keeps the slot number (in the "virtualPage"
+//	field, which is otherwise unused with a linear page table).  The
+//	slots are given back when the address space goes away.
+//
+//	The swap space remembers which slots hold a valid copy of their
+//	page.  A page is written to its slot only when it is evicted
+//	dirty; until then, the slot has no copy, and the page is read
+//	from the program's executable (see AddrSpace::LoadPage).  A clean
+//	page can always just be dropped.
+//
+//	Swap space is either a Nachos file, or a disk of its own (a "raw
+//	partition"), read and written a page at a time without going
+//	through the file system.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPSPACE_H
+#define SWAPSPACE_H
+
+#include "copyright.h"
+#include "bitmap.h"
+#include "filesys.h"
+
+class SynchDisk;
+
+#define SwapSlots	1024		// Most pages swap space can hold
+
+// The following class defines the swap space.
+
+class SwapSpace {
+  public:
+    SwapSpace(OpenFile *file);		// Use "file" for swap space
+    SwapSpace(SynchDisk *device);	// Use the whole of "device"
+    ~SwapSpace();
+
+    int AllocateSlot();			// Give a page a slot, with no copy
+					// of the page yet
+    void FreeSlot(int slot);		// The page is gone
+    bool HasCopy(int slot) { return valid->Test(slot); }
+					// Does the slot hold its page?
+    void WriteSlot(int slot, char *page);// Write a page to its slot
+    void ReadSlot(int slot, char *page);// Read a page from its slot
+
+  private:
+    OpenFile *file;			// Where the slots are, or NULL
+    SynchDisk *device;			// ... if they are on a disk
+    int sectorsPerSlot;			// Sectors of "device" per slot
+    char *slotBuffer;			// A slot's sectors, for "device"
+    int numSlots;			// # of slots swap space can hold
+    Bitmap *used;			// Slots given to pages
+    Bitmap *valid;			// Slots holding a copy of their page
+
+    void Initialize(int howMany);	// Set up "howMany" free slots
+    void TransferSlot(int slot, bool writing);
+					// Read or write a slot's sectors
+					// from or to "slotBuffer"
+};
+
+#endif // SWAPSPACE_H
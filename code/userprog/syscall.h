@@ -39,6 +39,7 @@
 #define SC_ThreadJoin   15
 #define SC_Fork_POS   16 //modification
 #define SC_Wait_POS   17
+#define SC_Fsync	18
 
 #define SC_Add		42
 
@@ -148,6 +149,13 @@ int Seek(int position, OpenFileId id);
  */
 int Close(OpenFileId id);
 
+/* Force everything written to the open file "id" out to the disk;
+ * return only once it is there.  (Writes normally stay in the kernel's
+ * buffer cache for a while.)  Return 0 on success, -1 if "id" is not
+ * an open file.
+ */
+int Fsync(OpenFileId id);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
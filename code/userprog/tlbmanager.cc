@@ -0,0 +1,222 @@
+// tlbmanager.cc
+//	Routines to refill the software-loaded TLB from the page tables,
+//	and to keep the page tables' use and dirty bits up to date.
+//
+//	All of these run in the kernel with the frame table's lock held
+//	(page faults, address spaces going away), or with interrupts
+//	disabled (aging the pages at a timer interrupt); none of them
+//	blocks.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "main.h"
+#include "tlbmanager.h"
+#include "machine.h"
+#include "sysdep.h"
+
+//----------------------------------------------------------------------
+// TLBManager::TLBManager
+// 	Initialize the kernel's side of the TLB, and invalidate every
+//	entry.
+//
+//	"policy" -- how to choose the entry to replace
+//----------------------------------------------------------------------
+
+TLBManager::TLBManager(TLBReplacement policy)
+{
+    Machine *machine = kernel->machine;
+
+    ASSERT(machine->tlb != NULL);
+    this->policy = policy;
+    asids = new Bitmap(MaxASIDs);
+    asids->Mark(0);			// what the machine starts with
+    source = new TranslationEntry *[machine->tlbSize];
+    loadTime = new int[machine->tlbSize];
+    for (int i = 0; i < machine->tlbSize; i++) {
+	machine->tlb[i].valid = FALSE;
+	source[i] = NULL;
+	loadTime[i] = 0;
+    }
+    numRefills = 0;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::~TLBManager
+// 	De-allocate the kernel's side of the TLB.
+//----------------------------------------------------------------------
+
+TLBManager::~TLBManager()
+{
+    delete [] loadTime;
+    delete [] source;
+    delete asids;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::AllocateASID
+// 	Return an address space id no other address space has.
+//----------------------------------------------------------------------
+
+int
+TLBManager::AllocateASID()
+{
+    int asid = asids->FindAndSet();
+
+    ASSERT(asid != -1);			// too many address spaces
+    return asid;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::FreeASID
+// 	An address space has gone away.  Drop the TLB entries loaded for
+//	it, so that a new space given the same id does not match them.
+//
+//	"asid" -- the id of the address space
+//----------------------------------------------------------------------
+
+void
+TLBManager::FreeASID(int asid)
+{
+    Machine *machine = kernel->machine;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	if (machine->tlb[i].valid && (machine->tlbASID[i] == asid)) {
+	    Evict(i);
+	}
+    }
+    asids->Clear(asid);
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Refill
+// 	Load the translation of a virtual page of the running address
+//	space into the TLB, which missed it.  The page is in memory.
+//
+//	"vpn" -- the virtual page number
+//	"entry" -- its page table entry
+//----------------------------------------------------------------------
+
+void
+TLBManager::Refill(int vpn, TranslationEntry *entry)
+{
+    Machine *machine = kernel->machine;
+    int slot = FindVictim();
+
+    ASSERT(entry->valid);
+    Evict(slot);
+    machine->tlb[slot] = *entry;
+    machine->tlb[slot].virtualPage = vpn;	// the page table keeps the
+						// swap slot there
+    machine->tlb[slot].use = FALSE;
+    machine->tlb[slot].dirty = FALSE;
+    machine->tlbASID[slot] = machine->currentASID;
+    machine->tlbLastUsed[slot] = kernel->stats->totalTicks;
+    source[slot] = entry;
+    loadTime[slot] = numRefills++;
+    DEBUG(dbgAddr, "TLB entry " << slot << " now maps page " << vpn
+		<< " of address space " << machine->currentASID);
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Invalidate
+// 	The page of "entry" is being evicted from memory; drop its TLB
+//	entry, if any, folding its bits back first so that the caller
+//	sees whether the page is dirty.
+//
+//	"entry" -- the page table entry of the page
+//----------------------------------------------------------------------
+
+void
+TLBManager::Invalidate(TranslationEntry *entry)
+{
+    for (int i = 0; i < kernel->machine->tlbSize; i++) {
+	if (source[i] == entry) {
+	    Evict(i);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// TLBManager::SyncBits
+// 	Fold the use and dirty bits of every TLB entry into the page table
+//	entry it was loaded from.  The TLB entries' use bits are cleared,
+//	so that the page replacement policy can clear the page tables'
+//	and see the page used again.
+//----------------------------------------------------------------------
+
+void
+TLBManager::SyncBits()
+{
+    Machine *machine = kernel->machine;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	if (source[i] != NULL) {
+	    source[i]->use |= machine->tlb[i].use;
+	    source[i]->dirty |= machine->tlb[i].dirty;
+	    machine->tlb[i].use = FALSE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// TLBManager::FindVictim
+// 	Return the TLB entry to load a new translation into: an invalid
+//	one if there is one, otherwise one chosen by the policy.
+//----------------------------------------------------------------------
+
+int
+TLBManager::FindVictim()
+{
+    Machine *machine = kernel->machine;
+    int victim = 0;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	if (!machine->tlb[i].valid) {
+	    return i;
+	}
+    }
+    switch (policy) {
+      case TLBRandom:
+	victim = RandomNumber() % machine->tlbSize;
+	break;
+      case TLBFIFO:
+	for (int i = 1; i < machine->tlbSize; i++) {
+	    if (loadTime[i] < loadTime[victim]) {
+		victim = i;
+	    }
+	}
+	break;
+      case TLBLRU:
+	for (int i = 1; i < machine->tlbSize; i++) {
+	    if (machine->tlbLastUsed[i] < machine->tlbLastUsed[victim]) {
+		victim = i;
+	    }
+	}
+	break;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Evict
+// 	Fold the use and dirty bits of a TLB entry back into the page
+//	table entry it was loaded from, and invalidate it.
+//
+//	"slot" -- the TLB entry
+//----------------------------------------------------------------------
+
+void
+TLBManager::Evict(int slot)
+{
+    Machine *machine = kernel->machine;
+
+    if (source[slot] != NULL) {
+	source[slot]->use |= machine->tlb[slot].use;
+	source[slot]->dirty |= machine->tlb[slot].dirty;
+	source[slot] = NULL;
+    }
+    machine->tlb[slot].valid = FALSE;
+}
@@ -0,0 +1,78 @@
+// tlbmanager.h
+//	Data structures to manage a software-loaded TLB.
+//
+//	When the machine has a TLB, it translates addresses only through
+//	the TLB; a miss traps to the kernel as a page fault, and the page
+//	fault handler loads ("refills") the missing translation from the
+//	address space's page table, after bringing the page in if it is
+//	not in memory.  When the TLB is full, the entry to replace is
+//	chosen at random (as the MIPS hardware does), in FIFO order, or
+//	least recently used first.
+//
+//	Each address space has an id (ASID), and each TLB entry is tagged
+//	with the id of the space it was loaded for, so that a context
+//	switch does not have to flush the TLB: entries of other spaces
+//	simply do not match.
+//
+//	The machine sets the use and dirty bits of the TLB entry, not of
+//	the page table entry it was loaded from.  The manager remembers
+//	that entry, and folds the bits back into it when the TLB entry
+//	is replaced, when the page leaves memory, and before the page
+//	replacement policy looks at them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBMANAGER_H
+#define TLBMANAGER_H
+
+#include "copyright.h"
+#include "translate.h"
+#include "bitmap.h"
+
+#define MaxASIDs	64		// Most address spaces at once
+
+// How the TLB entry to replace is chosen
+
+enum TLBReplacement {
+    TLBRandom,				// Any entry
+    TLBFIFO,				// The one loaded first
+    TLBLRU				// The one matched least recently
+};
+
+// The following class defines the kernel's side of the TLB.
+
+class TLBManager {
+  public:
+    TLBManager(TLBReplacement policy);	// Initialize, with the TLB empty
+    ~TLBManager();
+
+    int AllocateASID();			// An id for a new address space
+    void FreeASID(int asid);		// The space is gone; drop its
+					// entries
+
+    void Refill(int vpn, TranslationEntry *entry);
+					// Load the translation of virtual
+					// page "vpn" of the running space
+    void Invalidate(TranslationEntry *entry);
+					// The page is leaving memory; drop
+					// any entry loaded from "entry"
+    void SyncBits();			// Fold the use and dirty bits of
+					// every entry into the page tables
+
+  private:
+    TLBReplacement policy;
+    Bitmap *asids;			// ASIDs in use
+    TranslationEntry **source;		// For each TLB entry, the page table
+					// entry it was loaded from, or NULL
+    int *loadTime;			// For FIFO: when each entry was
+					// loaded, counting refills
+    int numRefills;			// Refills so far
+
+    int FindVictim();			// Choose the entry to replace
+    void Evict(int slot);		// Fold back the bits of a TLB entry,
+					// and invalidate it
+};
+
+#endif // TLBMANAGER_H